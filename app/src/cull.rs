@@ -0,0 +1,219 @@
+//! Decide which mirrored windows can be seen from the HMD, so windows outside the field of view
+//! or covered by other windows don't have to be uploaded until they come back into view.
+
+use graphene::{Matrix, Point3D};
+
+/// Added to each side of the field of view, in degrees, so windows are refreshed a bit before
+/// head movement brings them into view.
+const FOV_MARGIN_DEGREES: f32 = 10.0;
+/// Occluders are shrunk by this fraction on each side, the eyes aren't exactly at the head
+/// position so they see a little around the edges.
+const OCCLUDER_MARGIN: f32 = 0.05;
+
+/// Head pose and field of view, everything below is in head space. The HMD looks down -z.
+#[derive(Debug, Clone)]
+pub struct View {
+    world_to_head: Matrix,
+    /// Tangents of the field of view angles, left and bottom are usually negative
+    left: f32,
+    right: f32,
+    top: f32,
+    bottom: f32,
+    /// Vertical resolution of the HMD display per radian, 0 if unknown
+    pixels_per_radian: f32,
+}
+
+impl View {
+    /// `left`, `right`, `top` and `bottom` are the angles in degrees from the view axis, as
+    /// returned by `gxr_context_get_frustum_angles`, covering both eyes. `display_height` is the
+    /// vertical render resolution of one eye.
+    pub fn new(
+        head_pose: &Matrix,
+        left: f32,
+        right: f32,
+        top: f32,
+        bottom: f32,
+        display_height: u32,
+    ) -> Option<Self> {
+        let tan = |degrees: f32| degrees.clamp(-89.0, 89.0).to_radians().tan();
+        let fov = (top - bottom).to_radians();
+        Some(Self {
+            world_to_head: head_pose.inverse()?,
+            pixels_per_radian: if fov > 0.0 {
+                display_height as f32 / fov
+            } else {
+                0.0
+            },
+            left: tan(left - FOV_MARGIN_DEGREES),
+            right: tan(right + FOV_MARGIN_DEGREES),
+            top: tan(top + FOV_MARGIN_DEGREES),
+            bottom: tan(bottom - FOV_MARGIN_DEGREES),
+        })
+    }
+
+    /// Place a window quad in head space. `transform` is the window transformation including
+    /// scale, which maps the window to a quad of height 1 centered at the origin.
+    pub fn quad(&self, transform: &Matrix, width: u32, height: u32, opaque: bool) -> Option<Quad> {
+        if width == 0 || height == 0 {
+            return None;
+        }
+        let half_width = width as f32 / height as f32 / 2.0;
+        let local_to_head = transform.multiply(&self.world_to_head);
+        let corners = [(-1.0, -1.0), (1.0, -1.0), (1.0, 1.0), (-1.0, 1.0)].map(|(x, y)| {
+            local_to_head.transform_point3d(&Point3D::new(x * half_width, y * 0.5, 0.0))
+        });
+        let center = local_to_head.transform_point3d(&Point3D::new(0.0, 0.0, 0.0));
+        let normal = local_to_head.transform_point3d(&Point3D::new(0.0, 0.0, 1.0));
+        Some(Quad {
+            corners,
+            center,
+            normal: Point3D::new(
+                normal.x() - center.x(),
+                normal.y() - center.y(),
+                normal.z() - center.z(),
+            ),
+            head_to_local: local_to_head.inverse()?,
+            half_width,
+            opaque,
+        })
+    }
+
+    /// How many window pixels cover one pixel of the HMD display, for a window `height` pixels
+    /// high shown as `quad`.
+    pub fn downscale(&self, quad: &Quad, height: u32) -> f32 {
+        let [bottom, _, _, top] = &quad.corners;
+        let world_height = distance(bottom, top);
+        let distance = dot(&quad.center, &quad.center).sqrt();
+        let angle = 2.0 * (world_height / 2.0).atan2(distance);
+        let pixels = angle * self.pixels_per_radian;
+        if pixels > 0.0 {
+            height as f32 / pixels
+        } else {
+            1.0
+        }
+    }
+
+    /// Angle between the view direction and the center of `quad`, in degrees.
+    pub fn angle(&self, quad: &Quad) -> f32 {
+        let distance = dot(&quad.center, &quad.center).sqrt();
+        if distance > 0.0 {
+            (-quad.center.z() / distance)
+                .clamp(-1.0, 1.0)
+                .acos()
+                .to_degrees()
+        } else {
+            0.0
+        }
+    }
+
+    /// Whether any part of `quad` can be within the field of view. Conservative, the quad is
+    /// only rejected if all of its corners are outside of the same frustum plane.
+    pub fn contains(&self, quad: &Quad) -> bool {
+        let outside = |test: &dyn Fn(&Point3D) -> bool| quad.corners.iter().all(test);
+        !(outside(&|p| p.z() >= 0.0)
+            || outside(&|p| p.x() < self.left * -p.z())
+            || outside(&|p| p.x() > self.right * -p.z())
+            || outside(&|p| p.y() > self.top * -p.z())
+            || outside(&|p| p.y() < self.bottom * -p.z()))
+    }
+}
+
+/// How a window that can be seen appears from the HMD
+#[derive(Debug, Clone, Copy)]
+pub struct Sight {
+    /// See `View::downscale`
+    pub downscale: f32,
+    /// See `View::angle`
+    pub angle: f32,
+}
+
+impl Sight {
+    pub fn new(view: &View, quad: &Quad, height: u32) -> Self {
+        Self {
+            downscale: view.downscale(quad, height),
+            angle: view.angle(quad),
+        }
+    }
+}
+
+/// Used when the window's geometry isn't known: full resolution, straight ahead
+impl Default for Sight {
+    fn default() -> Self {
+        Self {
+            downscale: 1.0,
+            angle: 0.0,
+        }
+    }
+}
+
+#[derive(Debug, Clone)]
+pub struct Quad {
+    /// Corners in head space
+    corners: [Point3D; 4],
+    center: Point3D,
+    normal: Point3D,
+    head_to_local: Matrix,
+    half_width: f32,
+    /// Whether windows behind this one are hidden by it
+    opaque: bool,
+}
+
+fn dot(a: &Point3D, b: &Point3D) -> f32 {
+    a.x() * b.x() + a.y() * b.y() + a.z() * b.z()
+}
+
+fn distance(a: &Point3D, b: &Point3D) -> f32 {
+    let d = Point3D::new(a.x() - b.x(), a.y() - b.y(), a.z() - b.z());
+    dot(&d, &d).sqrt()
+}
+
+impl Quad {
+    /// Whether this quad completely covers `other` as seen from the head.
+    pub fn occludes(&self, other: &Quad) -> bool {
+        if !self.opaque {
+            return false;
+        }
+        let plane_distance = dot(&self.normal, &self.center);
+        let max_x = self.half_width * (1.0 - OCCLUDER_MARGIN);
+        let max_y = 0.5 * (1.0 - OCCLUDER_MARGIN);
+        // The quads are convex, so `other` is covered if the lines of sight to all of its
+        // corners pass through this quad before reaching the corner.
+        other.corners.iter().all(|corner| {
+            let denominator = dot(&self.normal, corner);
+            if denominator.abs() < f32::EPSILON {
+                return false;
+            }
+            let t = plane_distance / denominator;
+            if t <= 0.0 || t >= 1.0 {
+                return false;
+            }
+            let hit = Point3D::new(corner.x() * t, corner.y() * t, corner.z() * t);
+            let local = self.head_to_local.transform_point3d(&hit);
+            local.x().abs() <= max_x && local.y().abs() <= max_y
+        })
+    }
+}
+
+/// Returns for each quad whether it can be seen. `None` quads, whose geometry isn't known, are
+/// considered visible and never occlude anything.
+pub fn visible(view: &View, quads: &[Option<Quad>]) -> Vec<bool> {
+    let in_view: Vec<_> = quads
+        .iter()
+        .map(|quad| quad.as_ref().map(|quad| view.contains(quad)))
+        .collect();
+    quads
+        .iter()
+        .zip(&in_view)
+        .map(|(quad, &in_view)| {
+            let (Some(quad), Some(true)) = (quad, in_view) else {
+                return in_view.is_none();
+            };
+            !quads.iter().zip(&in_view).any(|(other, &other_in_view)| {
+                other_in_view == Some(true)
+                    && other.as_ref().map_or(false, |other| {
+                        !std::ptr::eq(other, quad) && other.occludes(quad)
+                    })
+            })
+        })
+        .collect()
+}
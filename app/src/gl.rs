@@ -17,6 +17,47 @@ pub struct Texture {
     width: u32,
     height: u32,
 }
+
+/// A GL semaphore imported from Vulkan
+#[derive(Debug)]
+pub struct Semaphore {
+    id: u32,
+}
+
+/// A copy for `Gl::blit_batch` to do
+#[derive(Debug)]
+pub struct BlitJob<'a> {
+    pub src: &'a Texture,
+    pub dst: &'a Texture,
+    /// Parts of `src` to copy, `None` means the whole texture
+    pub rects: Option<&'a [xproto::Rectangle]>,
+    /// Level of detail, `src` is downscaled by 2^lod into `dst`
+    pub lod: u32,
+    /// Semaphore to signal when the copy is done, and the layout `dst` should be in for Vulkan
+    pub signal: Option<(&'a Semaphore, ash::vk::ImageLayout)>,
+}
+
+/// `BlitJob` that can be sent to the GL thread
+pub struct RawBlitJob {
+    src: usize,
+    dst: usize,
+    rects: Option<Vec<xproto::Rectangle>>,
+    lod: u32,
+    signal: Option<(u32, ash::vk::ImageLayout)>,
+}
+
+impl From<&BlitJob<'_>> for RawBlitJob {
+    fn from(job: &BlitJob<'_>) -> Self {
+        Self {
+            src: job.src.id,
+            dst: job.dst.id,
+            rects: job.rects.map(<[_]>::to_vec),
+            lod: job.lod,
+            signal: job.signal.map(|(semaphore, layout)| (semaphore.id, layout)),
+        }
+    }
+}
+
 impl Texture {
     pub fn width(&self) -> u32 {
         self.width
@@ -65,6 +106,10 @@ pub enum Error {
     NoFbConfig(xproto::Visualid),
     #[error("failed to create GLXPixmap")]
     PixmapCreation,
+    #[error("{0} is not supported")]
+    MissingExtension(&'static str),
+    #[error("failed to import semaphore")]
+    SemaphoreImport,
 }
 
 type Result<T> = std::result::Result<T, Error>;
@@ -74,6 +119,15 @@ enum AnyTexture2d {
     Linear(Texture2d),
 }
 
+impl AnyTexture2d {
+    fn dimensions(&self) -> (u32, u32) {
+        match self {
+            AnyTexture2d::Srgb(t) => t.dimensions(),
+            AnyTexture2d::Linear(t) => t.dimensions(),
+        }
+    }
+}
+
 impl<'a> ToColorAttachment<'a> for &'a AnyTexture2d {
     fn to_color_attachment(self) -> glium::framebuffer::ColorAttachment<'a> {
         match self {
@@ -90,6 +144,32 @@ impl<'a> AsUniformValue for &'a AnyTexture2d {
         }
     }
 }
+/// Samples a texture bilinearly, whatever filter the texture itself is set up with. The taps of
+/// the downscale shader are placed between texels and rely on this to average 4 at once.
+struct Bilinear<'a>(&'a AnyTexture2d);
+impl AsUniformValue for Bilinear<'_> {
+    fn as_uniform_value(&self) -> glium::uniforms::UniformValue<'_> {
+        use glium::uniforms::{
+            MagnifySamplerFilter, MinifySamplerFilter, SamplerBehavior, SamplerWrapFunction,
+            UniformValue,
+        };
+        let behavior = SamplerBehavior {
+            minify_filter: MinifySamplerFilter::Linear,
+            magnify_filter: MagnifySamplerFilter::Linear,
+            // Taps at the edges must not pick up the opposite edge
+            wrap_function: (
+                SamplerWrapFunction::Clamp,
+                SamplerWrapFunction::Clamp,
+                SamplerWrapFunction::Clamp,
+            ),
+            ..Default::default()
+        };
+        match self.0 {
+            AnyTexture2d::Srgb(t) => UniformValue::SrgbTexture2d(t, Some(behavior)),
+            AnyTexture2d::Linear(t) => UniformValue::Texture2d(t, Some(behavior)),
+        }
+    }
+}
 
 struct TextureInner {
     texture: AnyTexture2d,
@@ -97,7 +177,6 @@ struct TextureInner {
 }
 
 struct GlInner {
-    x11: Arc<RustConnection>,
     screen: u32,
     x11depths: Vec<xproto::Depth>,
     glium: glium::Display,
@@ -106,6 +185,7 @@ struct GlInner {
     gl: ffi::Gl,
     textures: HashMap<usize, TextureInner>,
     blit_shader: glium::Program,
+    has_semaphore_fd: bool,
 }
 
 impl Drop for GlInner {
@@ -129,6 +209,11 @@ struct Vertex {
 }
 implement_vertex!(Vertex, position);
 
+/// Two triangles covering the rectangle from (x0, y0) to (x1, y1)
+fn quad(x0: f32, y0: f32, x1: f32, y1: f32) -> [Vertex; 6] {
+    [[x0, y0], [x0, y1], [x1, y1], [x0, y0], [x1, y1], [x1, y0]].map(|position| Vertex { position })
+}
+
 impl GlInner {
     fn new(x11: Arc<RustConnection>, screen: u32) -> Result<GlInner> {
         use glium::glutin::platform::unix::EventLoopBuilderExtUnix;
@@ -161,29 +246,52 @@ impl GlInner {
                 vertex: "
                     #version 330
                     in vec2 position;
+                    uniform vec2 scale;
                     out vec2 tex_coord;
                     void main() {
                         gl_Position = vec4(position, 0, 1);
-                        tex_coord = position / 2.0 + vec2(0.5);
+                        tex_coord = (position / 2.0 + vec2(0.5)) * scale;
                     }
                 ",
                 fragment: "
                     #version 330
                     uniform sampler2D tex;
+                    // Bilinear taps per axis, each averages 2x2 texels. 1 when not downscaling.
+                    uniform int taps;
+                    uniform vec2 texel;
                     in vec4 gl_FragCoord;
                     in vec2 tex_coord;
                     out vec4 color;
                     void main() {
-                        color = texture(tex, tex_coord);
+                        vec4 sum = vec4(0);
+                        for (int y = 0; y < taps; y++) {
+                            for (int x = 0; x < taps; x++) {
+                                vec2 offset = (vec2(x, y) - float(taps - 1) / 2.0) * 2.0 * texel;
+                                sum += texture(tex, tex_coord + offset);
+                            }
+                        }
+                        color = sum / float(taps * taps);
                     }
                 ",
                 outputs_srgb: true,
             }
         )
         .unwrap();
+        let gl = ffi::Gl::load_with(|s| display.gl_window().get_proc_address(s));
+        // glXGetProcAddress returns non-null for any function name, so we have to check the
+        // extension list.
+        let has_semaphore_fd = unsafe {
+            let mut num_extensions = 0;
+            gl.GetIntegerv(ffi::NUM_EXTENSIONS, &mut num_extensions);
+            (0..num_extensions as u32).any(|i| {
+                let name = std::ffi::CStr::from_ptr(gl.GetStringi(ffi::EXTENSIONS, i) as _);
+                name.to_bytes() == b"GL_EXT_semaphore_fd"
+            })
+        };
+        log::info!("GL_EXT_semaphore_fd supported: {}", has_semaphore_fd);
         Ok(GlInner {
             x11depths: x11.setup().roots[screen as usize].allowed_depths.clone(),
-            gl: ffi::Gl::load_with(|s| display.gl_window().get_proc_address(s)),
+            gl,
             glium: display,
             blit_shader,
             bind_tex_image: unsafe {
@@ -198,8 +306,8 @@ impl GlInner {
             },
             screen,
             glx,
-            x11,
             textures: Default::default(),
+            has_semaphore_fd,
         })
     }
 
@@ -329,10 +437,14 @@ impl GlInner {
         }
         Err(Error::NoFbConfig(visual.visual_id))
     }
+    /// Bind a window pixmap of size `width` x `height` to a texture. The caller knows the size,
+    /// so we don't have to ask the X server.
     fn bind_texture(
         &mut self,
         pixmap: xproto::Pixmap,
         visual: xproto::Visualid,
+        width: u32,
+        height: u32,
     ) -> Result<Texture> {
         // TODO: handle y_inverted property
         let raw_display = self.glium.gl_window().window().xlib_display().unwrap();
@@ -342,7 +454,6 @@ impl GlInner {
         let fbconfig = self.find_fbconfig(depth, visual)?;
         log::info!("{:p}", raw_display);
 
-        let geometry = xproto::get_geometry(self.x11.as_ref(), pixmap)?.reply()?;
         let attrs = [
             GLX_TEXTURE_FORMAT_EXT,
             if depth == 32 {
@@ -401,10 +512,7 @@ impl GlInner {
                 texture_id,
                 true,
                 glium::texture::MipmapsOption::NoMipmap,
-                glium::texture::Dimensions::Texture2d {
-                    width: geometry.width as _,
-                    height: geometry.height as _,
-                },
+                glium::texture::Dimensions::Texture2d { width, height },
             )
         };
         self.glium.assert_no_error(None);
@@ -417,8 +525,8 @@ impl GlInner {
         );
         Ok(Texture {
             id: texture_id as _,
-            width: geometry.width as _,
-            height: geometry.height as _,
+            width,
+            height,
         })
     }
     fn release_texture(&mut self, tex: Texture) -> Result<()> {
@@ -468,38 +576,70 @@ impl GlInner {
         );
         Ok(id)
     }
-    fn blit(&mut self, src: usize, dst: usize) -> Result<()> {
+    /// Copy `rects` of `src` into the same location in `dst`, downscaled by 2^`lod`. If `rects`
+    /// is `None`, the whole texture is copied, if it is empty nothing is. `dst` can be bigger
+    /// than the downscaled `src`, then only its top left part is written. Doesn't wait for the
+    /// copy to finish.
+    fn draw_blit(
+        &self,
+        src: usize,
+        dst: usize,
+        rects: Option<&[xproto::Rectangle]>,
+        lod: u32,
+    ) -> Result<()> {
+        if rects.map_or(false, |rects| rects.is_empty()) {
+            return Ok(());
+        }
         use glium::uniform;
         let src = self.textures.get(&src).unwrap();
         let dst = self.textures.get(&dst).unwrap();
         let mut fb = glium::framebuffer::SimpleFrameBuffer::new(&self.glium, &dst.texture)?;
+        let (src_width, src_height) = src.texture.dimensions();
+        let (width, height) = dst.texture.dimensions();
+        let factor = 1 << lod;
         let uniform = uniform! {
-            tex: &src.texture
-        };
-        let vbo = glium::VertexBuffer::new(
-            &self.glium,
-            &[
-                Vertex {
-                    position: [-1.0, -1.0],
-                },
-                Vertex {
-                    position: [-1.0, 1.0],
-                },
-                Vertex {
-                    position: [1.0, 1.0],
-                },
-                Vertex {
-                    position: [1.0, -1.0],
-                },
+            tex: Bilinear(&src.texture),
+            scale: [
+                (width * factor) as f32 / src_width as f32,
+                (height * factor) as f32 / src_height as f32,
             ],
-        )
-        .unwrap();
-        let indices = glium::IndexBuffer::new(
-            &self.glium,
-            glium::index::PrimitiveType::TriangleStrip,
-            &[1u16, 2, 0, 3],
-        )
-        .unwrap();
+            taps: (factor as i32 / 2).max(1),
+            texel: [1.0 / src_width as f32, 1.0 / src_height as f32],
+        };
+        // Each rectangle becomes 2 triangles. The shader maps position to texture coordinates
+        // 1:1 (after scaling for the size difference), so a rectangle is drawn by covering it in
+        // normalized device coordinates. Rectangles are rounded outwards to whole downscaled
+        // pixels.
+        let (lod_width, lod_height) = (
+            (src_width + factor - 1) / factor,
+            (src_height + factor - 1) / factor,
+        );
+        let factor = factor as i32;
+        let down = |v: i32| v.div_euclid(factor);
+        let up = |v: i32| (v + factor - 1).div_euclid(factor);
+        let to_ndc = |v: i32, limit: u32, max: u32| {
+            (v.clamp(0, limit.min(max) as i32) as f32 / max as f32) * 2.0 - 1.0
+        };
+        let full = [xproto::Rectangle {
+            x: 0,
+            y: 0,
+            width: src_width as u16,
+            height: src_height as u16,
+        }];
+        let rects = rects.unwrap_or(&full[..]);
+        let vertices: Vec<_> = rects
+            .iter()
+            .flat_map(|r| {
+                quad(
+                    to_ndc(down(r.x.into()), lod_width, width),
+                    to_ndc(down(r.y.into()), lod_height, height),
+                    to_ndc(up(r.x as i32 + r.width as i32), lod_width, width),
+                    to_ndc(up(r.y as i32 + r.height as i32), lod_height, height),
+                )
+            })
+            .collect();
+        let vbo = glium::VertexBuffer::new(&self.glium, &vertices).unwrap();
+        let indices = glium::index::NoIndices(glium::index::PrimitiveType::TrianglesList);
         //let time = std::time::SystemTime::now()
         //    .duration_since(std::time::SystemTime::UNIX_EPOCH)
         //    .unwrap()
@@ -514,7 +654,62 @@ impl GlInner {
             &uniform,
             &Default::default(),
         )?;
-        self.glium.get_context().finish();
+        Ok(())
+    }
+    /// Do all the copies in `jobs`, then synchronize them all at once.
+    ///
+    /// Semaphores of jobs that have one are signaled after all the copies, after transitioning
+    /// their `dst` to the given Vulkan image layout. They are signaled even if a copy failed, so
+    /// Vulkan can always wait on them, and the first error is returned afterwards. If every job
+    /// has a semaphore, this returns without waiting for the GPU, otherwise this blocks until all
+    /// copies are finished.
+    fn blit_batch(&mut self, jobs: &[RawBlitJob]) -> Result<()> {
+        let mut first_error = None;
+        for job in jobs {
+            if let Err(e) = self.draw_blit(job.src, job.dst, job.rects.as_deref(), job.lod) {
+                first_error.get_or_insert(e);
+            }
+        }
+        let mut need_finish = false;
+        for job in jobs {
+            if let Some((semaphore, layout)) = job.signal {
+                let dst = job.dst as ffi::types::GLuint;
+                let layout = gl_layout(layout);
+                unsafe {
+                    self.gl
+                        .SignalSemaphoreEXT(semaphore, 0, std::ptr::null(), 1, &dst, &layout)
+                };
+            } else {
+                need_finish = true;
+            }
+        }
+        if need_finish {
+            self.glium.get_context().finish();
+        } else {
+            // The signal operations must have been submitted before Vulkan waits on them
+            self.glium.get_context().flush();
+        }
+        first_error.map_or(Ok(()), Err)
+    }
+    fn import_semaphore(&mut self, fd: RawFd) -> Result<Semaphore> {
+        if !self.has_semaphore_fd {
+            return Err(Error::MissingExtension("GL_EXT_semaphore_fd"));
+        }
+        let mut id = 0;
+        unsafe {
+            self.gl.GenSemaphoresEXT(1, &mut id);
+            // GL takes ownership of fd
+            self.gl
+                .ImportSemaphoreFdEXT(id, ffi::HANDLE_TYPE_OPAQUE_FD_EXT, fd);
+            if self.gl.IsSemaphoreEXT(id) == ffi::FALSE {
+                self.gl.DeleteSemaphoresEXT(1, &id);
+                return Err(Error::SemaphoreImport);
+            }
+        }
+        Ok(Semaphore { id })
+    }
+    fn release_semaphore(&mut self, semaphore: Semaphore) -> Result<()> {
+        unsafe { self.gl.DeleteSemaphoresEXT(1, &semaphore.id) };
         Ok(())
     }
     fn import_fd(&mut self, width: u32, height: u32, fd: RawFd, size: u64) -> Result<Texture> {
@@ -549,11 +744,54 @@ impl GlInner {
     }
 }
 
-use crate::utils::Remote;
+/// GL requests sent without the boxing of `Remote::call`. The ones made every frame are here,
+/// object creation still goes through `gen_remote_fn`.
+pub enum Command {
+    ReleaseTexture(Texture),
+    ReleaseSemaphore(Semaphore),
+    Capture(bool),
+    BlitBatch(Vec<RawBlitJob>, oneshot::Sender<Result<()>>),
+}
+
+impl Commands for GlInner {
+    type Command = Command;
+    fn handle(&mut self, command: Command) {
+        let result = match command {
+            Command::ReleaseTexture(texture) => self.release_texture(texture),
+            Command::ReleaseSemaphore(semaphore) => self.release_semaphore(semaphore),
+            Command::Capture(start) => self.capture(start),
+            Command::BlitBatch(jobs, reply) => {
+                // The caller reports errors
+                let _: Result<_, _> = reply.send(self.blit_batch(&jobs));
+                Ok(())
+            }
+        };
+        if let Err(e) = result {
+            log::error!("GL command failed: {}", e);
+        }
+    }
+}
+
+use crate::utils::{Commands, Remote};
+use tokio::sync::oneshot;
 
 #[derive(Clone, Debug)]
 pub struct Gl {
     inner: Remote<GlInner>,
+    has_semaphore_fd: bool,
+}
+
+/// Translate a Vulkan image layout to the corresponding GL_EXT_semaphore layout
+fn gl_layout(layout: ash::vk::ImageLayout) -> ffi::types::GLenum {
+    use ash::vk::ImageLayout;
+    match layout {
+        ImageLayout::GENERAL => ffi::LAYOUT_GENERAL_EXT,
+        ImageLayout::COLOR_ATTACHMENT_OPTIMAL => ffi::LAYOUT_COLOR_ATTACHMENT_EXT,
+        ImageLayout::SHADER_READ_ONLY_OPTIMAL => ffi::LAYOUT_SHADER_READ_ONLY_EXT,
+        ImageLayout::TRANSFER_SRC_OPTIMAL => ffi::LAYOUT_TRANSFER_SRC_EXT,
+        ImageLayout::TRANSFER_DST_OPTIMAL => ffi::LAYOUT_TRANSFER_DST_EXT,
+        _ => ffi::NONE,
+    }
 }
 
 #[allow(clippy::all)]
@@ -566,19 +804,63 @@ use crate::gen_remote_fn;
 #[allow(dead_code)]
 impl Gl {
     pub async fn new(x11: Arc<RustConnection>, screen: u32) -> Result<Self> {
+        let inner = Remote::new(move || GlInner::new(x11, screen)).await?;
+        let has_semaphore_fd = inner.call(|inner| inner.has_semaphore_fd).await?;
         Ok(Self {
-            inner: Remote::new(move || GlInner::new(x11, screen)).await?,
+            inner,
+            has_semaphore_fd,
         })
     }
 
+    /// Whether semaphores can be imported from Vulkan. If not, blits have to synchronize with
+    /// the CPU.
+    pub fn has_semaphore_fd(&self) -> bool {
+        self.has_semaphore_fd
+    }
+
     gen_remote_fn!(import_fd(width: u32, height: u32, fd: RawFd, size: u64) -> Texture);
-    gen_remote_fn!(bind_texture(pixmap: xproto::Pixmap, visual: xproto::Visualid) -> Texture);
-    gen_remote_fn!(capture(start: bool) -> ());
-    gen_remote_fn!(release_texture(texture: Texture) -> ());
-    pub async fn blit(&self, src: &Texture, dst: &Texture) -> Result<()> {
-        let src = src.id;
-        let dst = dst.id;
-        self.inner.call(move |inner| inner.blit(src, dst)).await?
+    gen_remote_fn!(
+        bind_texture(pixmap: xproto::Pixmap, visual: xproto::Visualid, width: u32, height: u32)
+            -> Texture
+    );
+    gen_remote_fn!(import_semaphore(fd: RawFd) -> Semaphore);
+    /// These don't wait for the GL thread, use `flush` if the order against something outside of
+    /// GL matters.
+    pub fn capture(&self, start: bool) -> Result<()> {
+        self.inner.send(Command::Capture(start))?;
+        Ok(())
+    }
+    pub fn release_texture(&self, texture: Texture) -> Result<()> {
+        self.inner.send(Command::ReleaseTexture(texture))?;
+        Ok(())
+    }
+    pub fn release_semaphore(&self, semaphore: Semaphore) -> Result<()> {
+        self.inner.send(Command::ReleaseSemaphore(semaphore))?;
+        Ok(())
+    }
+    /// Wait for everything sent to the GL thread so far to be done.
+    pub async fn flush(&self) -> Result<()> {
+        self.inner.flush().await?;
+        Ok(())
+    }
+    pub fn flush_sync(&self) -> Result<()> {
+        self.inner.flush_sync()?;
+        Ok(())
+    }
+    /// Wait for the GPU to finish everything GL was asked to do so far.
+    pub async fn finish(&self) -> Result<()> {
+        self.inner
+            .call(|inner| inner.glium.get_context().finish())
+            .await?;
+        Ok(())
+    }
+    /// Do all the copies in one trip to the GL thread, see `GlInner::blit_batch`. No semaphore
+    /// was signaled if this fails with `Error::Remote`.
+    pub async fn blit_batch(&self, jobs: &[BlitJob<'_>]) -> Result<()> {
+        let jobs = jobs.iter().map(Into::into).collect();
+        let (tx, rx) = oneshot::channel();
+        self.inner.send(Command::BlitBatch(jobs, tx))?;
+        rx.await.map_err(crate::utils::Error::from)?
     }
     #[allow(dead_code)]
     pub async fn with_glium<R: 'static + Send>(
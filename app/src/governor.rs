@@ -0,0 +1,205 @@
+//! Limit how often each window is refreshed, depending on how much attention the user is likely
+//! paying to it. Damage arriving between two refreshes is accumulated by X, so it is coalesced
+//! into the next one.
+
+use std::{
+    sync::atomic::{AtomicU64, Ordering},
+    time::{Duration, Instant},
+};
+
+use anyhow::{anyhow, Context};
+
+/// Environment variable the policy is read from, e.g.
+/// `focused=full,view=30,periphery=5,periphery-angle=30`. Keys left out keep their defaults.
+pub const POLICY_ENV: &str = "PICOM_XRD_UPDATE_RATES";
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Attention {
+    /// Hovered in VR, or focused in X
+    Focused,
+    /// Within `Policy::periphery_angle` of the view direction
+    InView,
+    /// Visible, but further from the view direction
+    Periphery,
+}
+
+impl Attention {
+    const ALL: [Self; 3] = [Self::Focused, Self::InView, Self::Periphery];
+    fn name(self) -> &'static str {
+        match self {
+            Self::Focused => "focused",
+            Self::InView => "view",
+            Self::Periphery => "periphery",
+        }
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum Rate {
+    /// Every VR frame the window is damaged in
+    Full,
+    /// At most this many times per second
+    Hz(f32),
+    /// Not at all
+    Paused,
+}
+
+impl Rate {
+    /// Whether a window last refreshed at `last` can be refreshed in the frame starting at `now`.
+    /// Refreshes are rounded to the nearest frame, so e.g. 30 Hz is every third frame at 90 Hz.
+    pub fn due(self, last: Option<Instant>, now: Instant, frame: Duration) -> bool {
+        match (self, last) {
+            (Self::Paused, _) => false,
+            (Self::Full, _) | (_, None) => true,
+            (Self::Hz(hz), Some(last)) => {
+                now.saturating_duration_since(last) + frame / 2 >= Duration::from_secs_f32(1.0 / hz)
+            }
+        }
+    }
+
+    /// The earliest frame start at which `due` holds, `None` if it never does.
+    pub fn next_due(self, last: Option<Instant>, now: Instant, frame: Duration) -> Option<Instant> {
+        match (self, last) {
+            (Self::Paused, _) => None,
+            (Self::Full, _) | (_, None) => Some(now),
+            (Self::Hz(hz), Some(last)) => {
+                Some(last + Duration::from_secs_f32(1.0 / hz).saturating_sub(frame / 2))
+            }
+        }
+    }
+}
+
+impl std::str::FromStr for Rate {
+    type Err = anyhow::Error;
+    fn from_str(s: &str) -> Result<Self, Self::Err> {
+        match s {
+            "full" => Ok(Self::Full),
+            "off" => Ok(Self::Paused),
+            hz => match hz.parse::<f32>()? {
+                hz if hz == 0.0 => Ok(Self::Paused),
+                hz if hz > 0.0 && hz.is_finite() => Ok(Self::Hz(hz)),
+                hz => Err(anyhow!("invalid rate {hz}")),
+            },
+        }
+    }
+}
+
+impl std::fmt::Display for Rate {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        match self {
+            Self::Full => write!(f, "full"),
+            Self::Hz(hz) => write!(f, "{hz}Hz"),
+            Self::Paused => write!(f, "off"),
+        }
+    }
+}
+
+#[derive(Debug, Clone)]
+pub struct Policy {
+    focused: Rate,
+    in_view: Rate,
+    periphery: Rate,
+    /// Windows whose center is further than this from the view direction are in the periphery,
+    /// in degrees
+    periphery_angle: f32,
+}
+
+impl Default for Policy {
+    fn default() -> Self {
+        Self {
+            focused: Rate::Full,
+            in_view: Rate::Hz(30.0),
+            periphery: Rate::Hz(5.0),
+            periphery_angle: 30.0,
+        }
+    }
+}
+
+impl Policy {
+    /// Read the policy from `POLICY_ENV`, or use the default if it isn't set.
+    pub fn from_env() -> anyhow::Result<Self> {
+        let mut policy = Self::default();
+        let Ok(spec) = std::env::var(POLICY_ENV) else {
+            return Ok(policy);
+        };
+        for entry in spec.split(',').map(str::trim).filter(|e| !e.is_empty()) {
+            let (key, value) = entry
+                .split_once('=')
+                .with_context(|| anyhow!("{POLICY_ENV}: expected key=value, got {entry}"))?;
+            let context = || anyhow!("{POLICY_ENV}: invalid value for {key}");
+            match key.trim() {
+                "focused" => policy.focused = value.trim().parse().with_context(context)?,
+                "view" => policy.in_view = value.trim().parse().with_context(context)?,
+                "periphery" => policy.periphery = value.trim().parse().with_context(context)?,
+                "periphery-angle" => {
+                    policy.periphery_angle = value.trim().parse().with_context(context)?
+                }
+                key => return Err(anyhow!("{POLICY_ENV}: unknown key {key}")),
+            }
+        }
+        Ok(policy)
+    }
+    /// `angle` is between the view direction and the window center, in degrees.
+    pub fn attention(&self, focused: bool, angle: f32) -> Attention {
+        if focused {
+            Attention::Focused
+        } else if angle <= self.periphery_angle {
+            Attention::InView
+        } else {
+            Attention::Periphery
+        }
+    }
+    pub fn rate(&self, attention: Attention) -> Rate {
+        match attention {
+            Attention::Focused => self.focused,
+            Attention::InView => self.in_view,
+            Attention::Periphery => self.periphery,
+        }
+    }
+}
+
+impl std::fmt::Display for Policy {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        write!(
+            f,
+            "focused={} view={} periphery={} periphery-angle={}",
+            self.focused, self.in_view, self.periphery, self.periphery_angle
+        )
+    }
+}
+
+/// Refreshes done and held back for each `Attention`
+#[derive(Debug, Default)]
+pub struct Stats {
+    refreshed: [AtomicU64; 3],
+    deferred: [AtomicU64; 3],
+}
+
+impl Stats {
+    pub fn refreshed(&self, attention: Attention) {
+        self.refreshed[attention as usize].fetch_add(1, Ordering::Relaxed);
+    }
+    /// A damaged window was held back by the rate for its attention. Counted once per update,
+    /// not for every frame it waits.
+    pub fn deferred(&self, attention: Attention) {
+        self.deferred[attention as usize].fetch_add(1, Ordering::Relaxed);
+    }
+}
+
+impl std::fmt::Display for Stats {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        for (i, attention) in Attention::ALL.into_iter().enumerate() {
+            if i > 0 {
+                write!(f, ", ")?;
+            }
+            write!(
+                f,
+                "{}: {} refreshed, {} deferred",
+                attention.name(),
+                self.refreshed[i].load(Ordering::Relaxed),
+                self.deferred[i].load(Ordering::Relaxed)
+            )?;
+        }
+        Ok(())
+    }
+}
@@ -0,0 +1,60 @@
+//! Latency histogram with power-of-two millisecond buckets, cheap enough to keep around for
+//! logging.
+
+use std::time::Duration;
+
+const BUCKETS: usize = 16;
+
+#[derive(Debug, Default)]
+pub struct Histogram {
+    /// Bucket `i` counts samples shorter than 2^i ms, and not in a lower bucket. The last bucket
+    /// also counts everything longer.
+    buckets: [u64; BUCKETS],
+    count: u64,
+    total: Duration,
+    max: Duration,
+}
+
+impl Histogram {
+    pub fn record(&mut self, sample: Duration) {
+        let ms = sample.as_millis() as u64;
+        let bucket = (u64::BITS - ms.leading_zeros()) as usize;
+        self.buckets[bucket.min(BUCKETS - 1)] += 1;
+        self.count += 1;
+        self.total += sample;
+        self.max = self.max.max(sample);
+    }
+    pub fn count(&self) -> u64 {
+        self.count
+    }
+    /// Upper bound of the bucket the `p`-th percentile falls into.
+    pub fn percentile(&self, p: f64) -> Duration {
+        let target = (self.count as f64 * p / 100.0).ceil() as u64;
+        let mut seen = 0;
+        for (i, &n) in self.buckets[..BUCKETS - 1].iter().enumerate() {
+            seen += n;
+            if seen >= target.max(1) {
+                return Duration::from_millis(1 << i);
+            }
+        }
+        self.max
+    }
+}
+
+impl std::fmt::Display for Histogram {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        if self.count == 0 {
+            return write!(f, "no samples");
+        }
+        write!(
+            f,
+            "n={} mean={:?} p50<{:?} p90<{:?} p99<{:?} max={:?}",
+            self.count,
+            self.total / self.count as u32,
+            self.percentile(50.0),
+            self.percentile(90.0),
+            self.percentile(99.0),
+            self.max
+        )
+    }
+}
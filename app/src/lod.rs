@@ -0,0 +1,30 @@
+//! Level of detail for distant windows. At level `n`, a window is copied into a texture
+//! downscaled by 2^n.
+
+/// Windows are downscaled by at most 2^MAX_LEVEL
+pub const MAX_LEVEL: u32 = 3;
+/// How far past the threshold between two levels the downscale factor has to go before the level
+/// changes, so windows at the threshold don't flip back and forth.
+const HYSTERESIS: f32 = 1.25;
+
+/// Level for a window that currently is at `current`. `downscale` is how many window pixels
+/// cover one pixel of the HMD display.
+pub fn level(current: u32, downscale: f32) -> u32 {
+    let mut level = current.min(MAX_LEVEL);
+    while level < MAX_LEVEL && downscale >= (1 << (level + 1)) as f32 * HYSTERESIS {
+        level += 1;
+    }
+    while level > 0 && downscale < (1 << level) as f32 / HYSTERESIS {
+        level -= 1;
+    }
+    level
+}
+
+/// Size of a `width` x `height` window at `level`
+pub fn size(width: u32, height: u32, level: u32) -> (u32, u32) {
+    let factor = 1 << level;
+    (
+        (width + factor - 1) / factor,
+        (height + factor - 1) / factor,
+    )
+}
@@ -2,14 +2,21 @@ use ::next_gen::prelude::*;
 use std::{
     cell::RefCell,
     collections::{hash_map::Entry, HashMap},
-    sync::{Arc, Weak},
+    sync::{
+        atomic::{AtomicBool, AtomicU32, AtomicU64, Ordering},
+        Arc, Weak,
+    },
+    time::{Duration, Instant},
 };
 
 use anyhow::{anyhow, Context};
 use drop_bomb::DropBomb;
 use futures::{StreamExt, TryStreamExt};
 use gio::prelude::*;
-use glib::{clone::Downgrade, translate::ToGlibPtr};
+use glib::{
+    clone::Downgrade,
+    translate::{IntoGlibPtr, ToGlibPtr, ToGlibPtrMut},
+};
 use gxr::ContextExt;
 use log::*;
 use tokio::{
@@ -21,19 +28,33 @@ use x11rb::{
     protocol::{
         composite::ConnectionExt as _,
         damage::{self, ConnectionExt as _},
+        dri3::{self, ConnectionExt as _},
+        xfixes::{self, ConnectionExt as _},
         xproto::{self, ConnectionExt as _},
     },
     rust_connection::RustConnection,
 };
 use xrd::{ClientExt, ClientExtExt, DesktopCursorExt, WindowExt};
 
+mod cull;
 mod gl;
+mod governor;
+mod histogram;
 mod input;
+mod lod;
 mod picom;
+mod pool;
 mod setup;
 mod utils;
 
 const PIXELS_PER_METER: f32 = 600.0;
+/// Frame duration to use if the VR runtime doesn't tell us its refresh rate
+const DEFAULT_FRAME_DURATION: Duration = Duration::from_micros(11_111);
+/// How many unused textures to keep around for reuse
+const TEXTURE_POOL_CAPACITY: usize = 16;
+/// How often the frame scheduler checks window visibility while nothing is damaged, to find
+/// windows that came closer and need a sharper texture
+const VISIBILITY_CHECK_INTERVAL: Duration = Duration::from_millis(100);
 type Result<T> = anyhow::Result<T>;
 
 x11rb::atom_manager! {
@@ -42,52 +63,251 @@ x11rb::atom_manager! {
     }
 }
 
+/// Semaphore signaled by GL when it is done writing to `SharedTexture::imported_texture`, so the
+/// Vulkan queue can wait for the blit instead of the CPU.
+#[derive(Debug)]
+struct Semaphore {
+    gulkan: gulkan::Client,
+    vk: ash::vk::Semaphore,
+    gl: gl::Semaphore,
+    /// Layout `remote_texture` is expected to be in on the Vulkan side
+    layout: ash::vk::ImageLayout,
+    /// Serial of the last graphics queue submission waiting on `vk`, 0 if there was none
+    last_wait: AtomicU64,
+}
+
+impl Semaphore {
+    /// `last_wait` is the serial of the last submission waiting on `vk`, which has to complete
+    /// before `vk` can be destroyed.
+    fn destroy_vk(gulkan: &gulkan::Client, vk: ash::vk::Semaphore, last_wait: u64) {
+        unsafe {
+            let device = gulkan::sys::gulkan_client_get_device(gulkan.as_ptr());
+            if last_wait != 0 {
+                gulkan::sys::gulkan_queue_wait(
+                    gulkan::sys::gulkan_device_get_graphics_queue(device),
+                    last_wait,
+                );
+            }
+            gulkan::sys::gulkan_device_destroy_semaphore(device, std::mem::transmute(vk));
+        }
+    }
+    /// Free a semaphore GL signaled but Vulkan never waited on. GL has to finish first, as
+    /// Vulkan can't destroy a semaphore with a pending signal operation.
+    async fn free_unwaited(self, gl: &gl::Gl) -> Result<()> {
+        gl.release_semaphore(self.gl)?;
+        gl.finish().await?;
+        block_in_place(|| Self::destroy_vk(&self.gulkan, self.vk, self.last_wait.into_inner()));
+        Ok(())
+    }
+}
+
+/// Texture shared between Vulkan and GL that window pixmaps are copied into. Kept in the texture
+/// pool when no window uses it.
+#[derive(Debug)]
+struct SharedTexture {
+    remote_texture: gulkan::Texture,
+    imported_texture: gl::Texture,
+    /// None if GL_EXT_semaphore_fd is not supported, then blits are synchronized with glFinish
+    semaphore: Option<Semaphore>,
+    /// Allocated size, which is the size class of the windows using it
+    class: (u32, u32),
+}
+
+impl SharedTexture {
+    /// Release the GL side, and return what's left to free on the Vulkan side once GL is done.
+    fn release_gl(
+        self,
+        gl: &gl::Gl,
+    ) -> Result<(
+        gulkan::Texture,
+        Option<(gulkan::Client, ash::vk::Semaphore, u64)>,
+    )> {
+        gl.release_texture(self.imported_texture)?;
+        let vk_semaphore = if let Some(Semaphore {
+            gulkan,
+            vk,
+            gl: gl_semaphore,
+            last_wait,
+            ..
+        }) = self.semaphore
+        {
+            gl.release_semaphore(gl_semaphore)?;
+            Some((gulkan, vk, last_wait.into_inner()))
+        } else {
+            None
+        };
+        Ok((self.remote_texture, vk_semaphore))
+    }
+    async fn free(self, gl: &gl::Gl) -> Result<()> {
+        let (remote_texture, vk_semaphore) = self.release_gl(gl)?;
+        gl.flush().await?;
+        drop(remote_texture);
+        if let Some((gulkan, vk, last_wait)) = vk_semaphore {
+            block_in_place(|| Semaphore::destroy_vk(&gulkan, vk, last_wait));
+        }
+        Ok(())
+    }
+    fn free_sync(self, gl: &gl::Gl) -> Result<()> {
+        let (remote_texture, vk_semaphore) = self.release_gl(gl)?;
+        gl.flush_sync()?;
+        drop(remote_texture);
+        if let Some((gulkan, vk, last_wait)) = vk_semaphore {
+            Semaphore::destroy_vk(&gulkan, vk, last_wait);
+        }
+        Ok(())
+    }
+}
+
+type TexturePool = Arc<std::sync::Mutex<pool::Pool<SharedTexture>>>;
+
+/// GL textures used to copy the window pixmap into `TextureSet::remote_texture`, for when the
+/// pixmap can't be imported into Vulkan directly.
+#[derive(Debug)]
+struct GlBlit {
+    x11_texture: gl::Texture,
+    /// Its `remote_texture` is the same as `TextureSet::remote_texture`, the window only covers
+    /// the top left part of it.
+    shared: SharedTexture,
+}
+
 #[derive(Debug)]
 struct TextureSet {
     x11_pixmap: xproto::Pixmap,
-    x11_texture: gl::Texture,
+    width: u32,
+    height: u32,
     remote_texture: gulkan::Texture,
-    imported_texture: gl::Texture,
+    /// None if `remote_texture` is the window pixmap itself, imported with DRI3
+    blit: Option<GlBlit>,
+    /// Level of detail the window is copied into `remote_texture` at, always 0 without `blit`
+    lod: u32,
 }
 
 impl TextureSet {
-    async fn free(this: Option<Self>, gl: &gl::Gl, x11: &RustConnection) -> Result<()> {
-        if let Some(Self {
+    /// Free the textures tied to the window pixmap, and return the texture that can be reused.
+    async fn free_pixmap(self, gl: &gl::Gl, x11: &RustConnection) -> Result<Option<SharedTexture>> {
+        block_in_place(|| Result::Ok(x11.free_pixmap(self.x11_pixmap)?.check()?))?;
+        if let Some(GlBlit {
             x11_texture,
-            x11_pixmap,
-            ..
-        }) = this
+            shared,
+        }) = self.blit
         {
-            block_in_place(|| Result::Ok(x11.free_pixmap(x11_pixmap)?.check()?))?;
-            gl.release_texture(x11_texture).await?;
+            gl.release_texture(x11_texture)?;
+            Ok(Some(shared))
+        } else {
+            Ok(None)
+        }
+    }
+    async fn free(
+        this: Option<Self>,
+        gl: &gl::Gl,
+        x11: &RustConnection,
+        pool: &TexturePool,
+    ) -> Result<()> {
+        if let Some(this) = this {
+            if let Some(shared) = this.free_pixmap(gl, x11).await? {
+                let evicted = pool.lock().unwrap().put(shared.class, shared);
+                if let Some(evicted) = evicted {
+                    evicted.free(gl).await?;
+                }
+            }
         }
         Ok(())
     }
-    fn free_sync(this: Option<Self>, gl: &gl::Gl, x11: &RustConnection) -> Result<()> {
+    fn free_sync(
+        this: Option<Self>,
+        gl: &gl::Gl,
+        x11: &RustConnection,
+        pool: &TexturePool,
+    ) -> Result<()> {
         if let Some(Self {
-            x11_texture,
-            x11_pixmap,
-            ..
+            x11_pixmap, blit, ..
         }) = this
         {
             x11.free_pixmap(x11_pixmap)?.check()?;
-            gl.release_texture_sync(x11_texture)?;
+            if let Some(GlBlit {
+                x11_texture,
+                shared,
+            }) = blit
+            {
+                gl.release_texture(x11_texture)?;
+                let evicted = pool.lock().unwrap().put(shared.class, shared);
+                if let Some(evicted) = evicted {
+                    evicted.free_sync(gl)?;
+                }
+            }
         }
         Ok(())
     }
 }
 
+/// Window geometry and stacking, kept up to date with ConfigureNotify
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+struct Geometry {
+    x: i16,
+    y: i16,
+    width: u16,
+    height: u16,
+    border_width: u16,
+    above_sibling: xproto::Window,
+}
+
+impl Geometry {
+    fn from_reply(reply: &xproto::GetGeometryReply) -> Self {
+        Self {
+            x: reply.x,
+            y: reply.y,
+            width: reply.width,
+            height: reply.height,
+            border_width: reply.border_width,
+            above_sibling: x11rb::NONE,
+        }
+    }
+}
+
+impl From<&xproto::ConfigureNotifyEvent> for Geometry {
+    fn from(event: &xproto::ConfigureNotifyEvent) -> Self {
+        Self {
+            x: event.x,
+            y: event.y,
+            width: event.width,
+            height: event.height,
+            border_width: event.border_width,
+            above_sibling: event.above_sibling,
+        }
+    }
+}
+
 #[derive(Debug)]
 struct Window {
     id: xproto::Window,
     gl: gl::Gl,
     name: String,
     damage: damage::Damage,
+    /// Region `damage` is subtracted into, so we know which parts of the window changed
+    damage_region: xfixes::Region,
     x11: Arc<RustConnection>,
     xrd: Arc<Mutex<xrd::Client>>,
     textures: Option<TextureSet>,
     xrd_window: Mutex<xrd::Window>,
-    client_wid: u32,
+    texture_pool: TexturePool,
+    /// Properties picom had for the window when it was mapped
+    picom: picom::WindowProperties,
+    visual: xproto::Visualid,
+    depth: u8,
+    /// Window has been damaged since it was last rendered
+    dirty: AtomicBool,
+    /// Level of detail the window should be rendered at, updated by the frame scheduler from
+    /// how big the window appears in the HMD
+    lod: AtomicU32,
+    /// When the frame scheduler last rendered the window
+    last_rendered: Option<Instant>,
+    /// The damage pending since then was already counted in `culled_updates`
+    culled: bool,
+    /// The damage pending since then was already counted as deferred in `update_stats`
+    deferred: bool,
+    /// When deferred damage can be rendered at the earliest, `None` if only after the window's
+    /// attention changes
+    deferred_until: Option<Instant>,
 
     // Dropping Window is unsafe, so we don't allow implicit dropping
     drop_bomb: DropBomb,
@@ -118,11 +338,13 @@ impl Window {
         let Self {
             xrd,
             damage,
+            damage_region,
             mut drop_bomb,
             x11,
             gl,
             xrd_window,
             textures,
+            texture_pool,
             ..
         } = self;
         drop_bomb.defuse();
@@ -138,7 +360,8 @@ impl Window {
             // damage will have already been freed is window is closed
             // so ignore error
             x11.damage_destroy(damage).unwrap().ignore_error();
-            TextureSet::free(textures, &gl, &x11).await
+            x11.xfixes_destroy_region(damage_region)?.ignore_error();
+            TextureSet::free(textures, &gl, &x11, &texture_pool).await
         }
     }
     // Must either be dropped with exclusive access to WindowState
@@ -146,11 +369,13 @@ impl Window {
         let Self {
             xrd,
             damage,
+            damage_region,
             mut drop_bomb,
             x11,
             gl,
             xrd_window,
             textures,
+            texture_pool,
             ..
         } = self;
         drop_bomb.defuse();
@@ -165,7 +390,8 @@ impl Window {
         // damage will have already been freed is window is closed
         // so ignore error
         x11.damage_destroy(damage).unwrap().ignore_error();
-        TextureSet::free_sync(textures, &gl, &x11)
+        x11.xfixes_destroy_region(damage_region)?.ignore_error();
+        TextureSet::free_sync(textures, &gl, &x11, &texture_pool)
     }
 }
 
@@ -199,6 +425,24 @@ struct App {
     last_set_cursor: RwLock<Option<(u32, i16, i16)>>,
     window_state: RwLock<WindowState>,
     pending_windows: Mutex<HashMap<u32, JoinHandle<()>>>,
+    /// X server supports DRI3 BuffersFromPixmap
+    has_dri3: bool,
+    texture_pool: TexturePool,
+    /// Geometry of the root window and the mirrored windows. Updated in the order of the
+    /// ConfigureNotify events, so it is kept outside of `window_state`.
+    geometries: std::sync::Mutex<HashMap<xproto::Window, Geometry>>,
+    /// Time from a window being mapped to it being shown in VR
+    map_latency: std::sync::Mutex<histogram::Histogram>,
+    /// Window updates uploaded to xrdesktop
+    uploaded_updates: AtomicU64,
+    /// Window updates held back because the window couldn't be seen, counted once per update
+    /// however long it is held
+    culled_updates: AtomicU64,
+    /// How often windows are refreshed depending on where the user's attention is
+    update_policy: governor::Policy,
+    update_stats: governor::Stats,
+    /// Mirrored window that has the X input focus, 0 if none
+    focused: AtomicU32,
 }
 
 #[derive(Debug)]
@@ -235,6 +479,39 @@ impl Drop for App {
                 // We own window_state at this point
                 unsafe { w.drop_sync().unwrap() };
             }
+            let mut pool = self.texture_pool.lock().unwrap();
+            info!(
+                "Texture pool hits: {}, misses: {}",
+                pool.hits(),
+                pool.misses()
+            );
+            for shared in pool.drain() {
+                shared.free_sync(&self.gl).unwrap();
+            }
+            info!("Window map latency: {}", self.map_latency.lock().unwrap());
+            info!(
+                "Window updates uploaded: {}, culled: {}",
+                self.uploaded_updates.load(Ordering::Relaxed),
+                self.culled_updates.load(Ordering::Relaxed)
+            );
+            info!("Window refresh rates: {}", self.update_stats);
+            if let Some(gulkan) = self.xrd_client.blocking_lock().gulkan() {
+                let (mut bytes_staged, mut wraps, mut fallbacks) = (0, 0, 0);
+                unsafe {
+                    gulkan::sys::gulkan_device_get_staging_stats(
+                        gulkan::sys::gulkan_client_get_device(gulkan.as_ptr()),
+                        &mut bytes_staged,
+                        &mut wraps,
+                        &mut fallbacks,
+                    )
+                };
+                info!(
+                    "Staging ring: {} MiB uploaded, {} wraps, {} dedicated buffers",
+                    bytes_staged / 1024 / 1024,
+                    wraps,
+                    fallbacks
+                );
+            }
         })
     }
 }
@@ -243,6 +520,8 @@ impl App {
         if !xrd::settings_is_schema_installed() {
             return Err(anyhow!("xrdesktop GSettings Schema not installed"));
         }
+        let update_policy = governor::Policy::from_env()?;
+        info!("Window refresh policy: {}", update_policy);
 
         let dbus = zbus::Connection::session().await.unwrap();
 
@@ -260,7 +539,7 @@ impl App {
             Mutex::new(inputsynth::InputSynth::new().expect("Failed to initialize inputsynth"));
         let (x11, screen) = RustConnection::connect(None)?;
         let x11 = Arc::new(x11);
-        block_in_place(|| {
+        let has_dri3 = block_in_place(|| {
             use x11rb::protocol::xfixes::{ConnectionExt, CursorNotifyMask};
             let (damage_major, damage_minor) = x11rb::protocol::damage::X11_XML_VERSION;
             x11.damage_query_version(damage_major, damage_minor)?
@@ -273,9 +552,28 @@ impl App {
                 CursorNotifyMask::DISPLAY_CURSOR,
             )?
             .check()?;
-            Result::Ok(())
+            // Keep track of the root window size
+            x11.change_window_attributes(
+                x11.setup().roots[screen].root,
+                &xproto::ChangeWindowAttributesAux::new()
+                    .event_mask(xproto::EventMask::STRUCTURE_NOTIFY),
+            )?
+            .check()?;
+            // BuffersFromPixmap is new in DRI3 1.2
+            if x11
+                .extension_information(dri3::X11_EXTENSION_NAME)?
+                .is_none()
+            {
+                return Result::Ok(false);
+            }
+            let dri3_version = x11.dri3_query_version(1, 2)?.reply()?;
+            Result::Ok((dri3_version.major_version, dri3_version.minor_version) >= (1, 2))
         })?;
+        info!("DRI3 pixmap import: {}", has_dri3);
         let atoms = AtomCollection::new(&*x11)?.reply()?;
+        let root = x11.setup().roots[screen].root;
+        let root_geometry =
+            block_in_place(|| Result::Ok(Geometry::from_reply(&x11.get_geometry(root)?.reply()?)))?;
 
         let cursor_window = xrd::Window::new_from_pixels(
             &client,
@@ -319,6 +617,17 @@ impl App {
             last_set_cursor: Default::default(),
             cursor_window: cursor_window.into(),
             pending_windows: Default::default(),
+            has_dri3,
+            texture_pool: Arc::new(std::sync::Mutex::new(pool::Pool::new(
+                TEXTURE_POOL_CAPACITY,
+            ))),
+            geometries: std::sync::Mutex::new([(root, root_geometry)].into()),
+            map_latency: Default::default(),
+            uploaded_updates: AtomicU64::new(0),
+            culled_updates: AtomicU64::new(0),
+            update_policy,
+            update_stats: Default::default(),
+            focused: AtomicU32::new(0),
         })
     }
 
@@ -402,21 +711,11 @@ impl App {
                     // this is not an error.
                     //
                     // problem caused by picom and X events are not synchronized.
-                    let mut w = w.write().await;
-
-                    // Window could've closed between damage_notify and here, handle that case.
-                    if block_in_place(|| {
-                        Result::Ok(
-                            self.x11
-                                .damage_subtract(w.damage, x11rb::NONE, x11rb::NONE)?
-                                .check()?,
-                        )
-                    })
-                    .is_ok()
-                    {
-                        // render_win will fail if window is closed, this is fine.
-                        let _: Result<_> = self.render_win(&mut w).await;
-                    }
+                    //
+                    // The damage is not subtracted here, so X accumulates it for us, and no more
+                    // DamageNotify will be sent for this window until it is rendered by
+                    // run_frame_scheduler.
+                    w.read().await.dirty.store(true, Ordering::Release);
                 }
             }
             Event::XfixesCursorNotify(xfixes::CursorNotifyEvent { cursor_serial, .. }) => {
@@ -427,24 +726,329 @@ impl App {
         Ok(())
     }
 
+    /// Take the region damaged since the last call, and reset the window's damage.
+    fn take_damage(&self, w: &Window) -> Result<Vec<xproto::Rectangle>> {
+        block_in_place(|| {
+            let cookie1 = self
+                .x11
+                .damage_subtract(w.damage, x11rb::NONE, w.damage_region)?;
+            let cookie2 = self.x11.xfixes_fetch_region(w.damage_region)?;
+            cookie1.check()?;
+            Result::Ok(cookie2.reply()?.rectangles)
+        })
+    }
+
+    /// Apply geometry changes to the cache. Called for every event before they are handled
+    /// concurrently, so the changes are applied in order.
+    fn update_geometries(&self, event: &x11rb::protocol::Event) {
+        use x11rb::protocol::Event;
+        let mut geometries = self.geometries.lock().unwrap();
+        match event {
+            Event::ConfigureNotify(event) => {
+                geometries.insert(event.window, event.into());
+            }
+            Event::DestroyNotify(event) => {
+                geometries.remove(&event.window);
+            }
+            _ => {}
+        }
+    }
+
+    /// Keep track of which mirrored window has the input focus. Like `update_geometries`, called
+    /// for every event in order.
+    fn update_focus(&self, event: &x11rb::protocol::Event) {
+        use x11rb::protocol::Event;
+        match event {
+            // Focus moving between a window and its children doesn't matter to us
+            Event::FocusIn(event) if event.detail != xproto::NotifyDetail::INFERIOR => {
+                self.focused.store(event.event, Ordering::Relaxed);
+            }
+            Event::FocusOut(event) if event.detail != xproto::NotifyDetail::INFERIOR => {
+                let _ = self.focused.compare_exchange(
+                    event.event,
+                    0,
+                    Ordering::Relaxed,
+                    Ordering::Relaxed,
+                );
+            }
+            _ => {}
+        }
+    }
+
+    /// Cached geometry of a mirrored window, or the root window.
+    fn geometry(&self, wid: xproto::Window) -> Result<Geometry> {
+        self.geometries
+            .lock()
+            .unwrap()
+            .get(&wid)
+            .copied()
+            .with_context(|| anyhow!("No geometry for window {wid:#010x}"))
+    }
+
+    /// Sleep until the next vsync of the HMD. Returns the frame duration.
+    async fn wait_for_next_frame(&self) -> Duration {
+        let (mut seconds_since_vsync, mut frame_duration) = (0.0f32, 0.0f32);
+        let has_timing = {
+            let xrd_client = self.xrd_client.lock().await;
+            let gxr = xrd_client.gxr_context().unwrap();
+            unsafe {
+                gxr::sys::gxr_context_get_frame_timing(
+                    gxr.as_ptr(),
+                    &mut seconds_since_vsync,
+                    &mut frame_duration,
+                ) != 0
+            }
+        };
+        let (delay, frame_duration) = if has_timing && frame_duration > 0.0 {
+            (
+                Duration::from_secs_f32((frame_duration - seconds_since_vsync).max(0.0)),
+                Duration::from_secs_f32(frame_duration),
+            )
+        } else {
+            (DEFAULT_FRAME_DURATION, DEFAULT_FRAME_DURATION)
+        };
+        tokio::time::sleep(delay).await;
+        frame_duration
+    }
+
+    /// Mirrored window hovered by a controller in VR
+    async fn hovered_window(&self) -> Option<u32> {
+        let xrd_client = self.xrd_client.lock().await;
+        let hovered = xrd_client.synth_hovered()?;
+        let mut native = 0u64;
+        unsafe {
+            gobject_sys::g_object_get(
+                hovered.as_ptr() as *mut _,
+                "native\0".as_bytes().as_ptr() as *const _,
+                &mut native as *mut _,
+                0,
+            );
+        }
+        Some(native as _)
+    }
+
+    /// Current head pose and field of view, `None` if the HMD isn't tracked.
+    async fn view(&self) -> Option<cull::View> {
+        let xrd_client = self.xrd_client.lock().await;
+        let gxr = xrd_client.gxr_context().unwrap();
+        let mut head_pose = graphene::Matrix::new_identity();
+        if unsafe {
+            gxr::sys::gxr_context_get_head_pose(gxr.as_ptr(), head_pose.to_glib_none_mut().0)
+        } == 0
+        {
+            return None;
+        }
+        // Field of view of both eyes combined
+        let mut angles = [[0.0f32; 4]; 2];
+        for (eye, [left, right, top, bottom]) in [gxr::sys::GXR_EYE_LEFT, gxr::sys::GXR_EYE_RIGHT]
+            .into_iter()
+            .zip(&mut angles)
+        {
+            unsafe {
+                gxr::sys::gxr_context_get_frustum_angles(
+                    gxr.as_ptr(),
+                    eye,
+                    left,
+                    right,
+                    top,
+                    bottom,
+                )
+            };
+        }
+        let [[left, _, top_left, bottom_left], [_, right, top_right, bottom_right]] = angles;
+        let mut extent = ash::vk::Extent2D::default();
+        unsafe {
+            gxr::sys::gxr_context_get_render_dimensions(
+                gxr.as_ptr(),
+                (&mut extent as *mut _).cast(),
+            )
+        };
+        cull::View::new(
+            &head_pose,
+            left,
+            right,
+            top_left.max(top_right),
+            bottom_left.min(bottom_right),
+            extent.height,
+        )
+    }
+
+    /// Ids of the windows that can currently be seen from the HMD, mapped to how they appear.
+    /// `None` if that is unknown.
+    async fn visible_windows(
+        &self,
+        window_state: &WindowState,
+    ) -> Option<HashMap<u32, cull::Sight>> {
+        let view = self.view().await?;
+        // Id and height of each window
+        let mut ids = Vec::with_capacity(window_state.windows.len());
+        let mut quads = Vec::with_capacity(window_state.windows.len());
+        for w in window_state.windows.values() {
+            let w = w.read().await;
+            let xrd_window = w.xrd_window.lock().await;
+            // Windows xrdesktop doesn't show are never visible
+            if !xrd_window.is_visible() {
+                continue;
+            }
+            let mut transform = graphene::Matrix::new_identity();
+            let data = unsafe { &*xrd::sys::xrd_window_get_data(xrd_window.as_ptr()) };
+            let quad = if xrd_window.is_transformation(&mut transform) {
+                // Windows with alpha don't hide what's behind them
+                view.quad(
+                    &transform,
+                    data.texture_width,
+                    data.texture_height,
+                    w.depth != 32,
+                )
+            } else {
+                None
+            };
+            ids.push((w.id, data.texture_height));
+            quads.push(quad);
+        }
+        Some(
+            ids.into_iter()
+                .zip(cull::visible(&view, &quads))
+                .zip(&quads)
+                .filter(|((_, visible), _)| *visible)
+                .map(|(((id, height), _), quad)| {
+                    let sight = quad.as_ref().map_or_else(Default::default, |quad| {
+                        cull::Sight::new(&view, quad, height)
+                    });
+                    (id, sight)
+                })
+                .collect(),
+        )
+    }
+
+    /// Render all damaged windows once per VR frame. No matter how often a window is damaged, it
+    /// is blitted and submitted at most once per frame.
+    ///
+    /// Windows that can't be seen stay dirty, and are rendered once they come back into view.
+    /// Windows far enough away are rendered at a lower level of detail. A window that comes
+    /// closer is re-rendered within `VISIBILITY_CHECK_INTERVAL`, one that moves away keeps its
+    /// sharper texture until it is damaged.
+    ///
+    /// Visible windows are rendered at most at the rate `update_policy` gives them, damage in
+    /// between is coalesced into the next refresh.
+    async fn run_frame_scheduler(self: Arc<Self>) {
+        let mut visibility_checked: Option<Instant> = None;
+        loop {
+            let frame_duration = self.wait_for_next_frame().await;
+            let now = Instant::now();
+            let window_state = self.window_state.read().await;
+            // Culling every window is only worth it when something has to be rendered. Without
+            // damage, it only finds windows that need a sharper texture, which can wait a bit.
+            // Damage that is held back, because the window was out of sight or is not due yet,
+            // waits for the next check as well, unless the window's refresh is due by now.
+            let mut any_dirty = false;
+            for w in window_state.windows.values() {
+                let r = w.read().await;
+                let held_back =
+                    r.culled || (r.deferred && r.deferred_until.map_or(true, |t| now < t));
+                if r.dirty.load(Ordering::Acquire) && !held_back {
+                    any_dirty = true;
+                    break;
+                }
+            }
+            if !any_dirty
+                && visibility_checked
+                    .map_or(false, |checked| now - checked < VISIBILITY_CHECK_INTERVAL)
+            {
+                continue;
+            }
+            visibility_checked = Some(now);
+            let visible = self.visible_windows(&window_state).await;
+            let hovered = self.hovered_window().await;
+            let focused = self.focused.load(Ordering::Relaxed);
+            let mut candidates = Vec::new();
+            for w in window_state.windows.values() {
+                let r = w.read().await;
+                let mut sharper = false;
+                if let Some(sight) = visible.as_ref().and_then(|visible| visible.get(&r.id)) {
+                    let level = lod::level(r.lod.load(Ordering::Relaxed), sight.downscale);
+                    r.lod.store(level, Ordering::Relaxed);
+                    sharper = r
+                        .textures
+                        .as_ref()
+                        .map_or(false, |ts| ts.blit.is_some() && level < ts.lod);
+                }
+                if sharper || r.dirty.load(Ordering::Acquire) {
+                    candidates.push((w, sharper));
+                }
+            }
+            if candidates.is_empty() {
+                continue;
+            }
+            let mut dirty = Vec::new();
+            for (w, sharper) in candidates {
+                let mut w = w.write().await;
+                let sight = match &visible {
+                    Some(visible) => match visible.get(&w.id) {
+                        Some(sight) => *sight,
+                        None => {
+                            // Count each held back update once, not every frame it is held
+                            if !std::mem::replace(&mut w.culled, true) {
+                                self.culled_updates.fetch_add(1, Ordering::Relaxed);
+                            }
+                            continue;
+                        }
+                    },
+                    None => Default::default(),
+                };
+                let is_focused = hovered == Some(w.id) || focused == w.id;
+                let attention = self.update_policy.attention(is_focused, sight.angle);
+                let rate = self.update_policy.rate(attention);
+                if !rate.due(w.last_rendered, now, frame_duration) {
+                    if !std::mem::replace(&mut w.deferred, true) {
+                        self.update_stats.deferred(attention);
+                    }
+                    w.deferred_until = rate.next_due(w.last_rendered, now, frame_duration);
+                    continue;
+                }
+                w.dirty.store(false, Ordering::Release);
+                // Window could've closed between damage_notify and here, handle that case. An
+                // empty region means the damage was already taken, there is nothing to copy
+                // unless the window needs a sharper texture, which is copied whole.
+                let damaged = match self.take_damage(&w) {
+                    Ok(_) if sharper => None,
+                    Ok(damaged) if !damaged.is_empty() => Some(damaged),
+                    _ => continue,
+                };
+                self.update_stats.refreshed(attention);
+                w.last_rendered = Some(now);
+                w.culled = false;
+                w.deferred = false;
+                w.deferred_until = None;
+                dirty.push((w, damaged));
+            }
+            if dirty.is_empty() {
+                continue;
+            }
+            // Render all windows damaged during this frame at once
+            let mut windows: Vec<_> = dirty
+                .iter_mut()
+                .map(|(w, damaged)| (&mut **w, std::mem::take(damaged)))
+                .collect();
+            // render_wins will fail for windows that are closed, this is fine.
+            let _: Result<_> = self.render_wins(&mut windows).await;
+        }
+    }
+
     async fn handle_input_events(&self, input_event: InputEvent) {
         trace!("{:?}", input_event);
         let raise_window_and_resolve_position = |wid, x, y| {
-            let geometry = block_in_place(|| {
-                let cookie1 = self
-                    .x11
-                    .configure_window(
-                        wid,
-                        &xproto::ConfigureWindowAux {
-                            stack_mode: Some(xproto::StackMode::ABOVE),
-                            ..Default::default()
-                        },
-                    )
-                    .unwrap();
-                let cookie2 = self.x11.get_geometry(wid).unwrap();
-                cookie1.check()?;
-                Result::Ok(cookie2.reply()?)
-            })?;
+            let geometry = self.geometry(wid)?;
+            // Don't wait for the reply, errors are reported as events.
+            self.x11
+                .configure_window(
+                    wid,
+                    &xproto::ConfigureWindowAux {
+                        stack_mode: Some(xproto::StackMode::ABOVE),
+                        ..Default::default()
+                    },
+                )?
+                .ignore_error();
             let x = (geometry.x as f32 + x) as _;
             let y = (geometry.y as f32 + y) as _;
             Result::Ok((x, y, x - geometry.x, y - geometry.y))
@@ -505,10 +1109,8 @@ impl App {
                         let windows = self.window_state.read().await;
                         if let Some(window) = windows.windows.get(&wid) {
                             let window = window.read().await;
-                            let Some((width, height)) = window
-                                .textures
-                                .as_ref()
-                                .map(|ts| (ts.x11_texture.width(), ts.x11_texture.height()))
+                            let Some((width, height)) =
+                                window.textures.as_ref().map(|ts| (ts.width, ts.height))
                             else {
                                 return
                             };
@@ -533,7 +1135,7 @@ impl App {
                                 &graphene::Point3D::new(x * width_meters, y * height_meters, 0.01),
                             );
                             let mut transform = translate.multiply(&transform);
-                            log::info!("transform: {:?}, window: {}", transform, window.name);
+                            log::info!("transform: {:?}, window: {}", transform, window.picom.name);
                             {
                                 let cursor_window = self.cursor_window.lock().await;
                                 cursor_window.set_transformation(&mut transform);
@@ -733,6 +1335,7 @@ impl App {
 
         let mut win_mapped = picom.receive_win_mapped().await?;
         let mut win_unmapped = picom.receive_win_unmapped().await?;
+        let scheduler = tokio::spawn(self.clone().run_frame_scheduler());
 
         info!("Existing windows mapped, entering mainloop");
         loop {
@@ -741,6 +1344,8 @@ impl App {
                     trace!("{:?}", event);
                     let this = self.clone();
                     let event = event.with_context(|| anyhow!("Xorg connection broke"))?;
+                    self.update_geometries(&event);
+                    self.update_focus(&event);
                     tokio::spawn(async move {
                         if let Err(e) = this.handle_x_events(event).await {
                             error!("Failed to handle X events {}", e);
@@ -782,7 +1387,7 @@ impl App {
                     let w = window_state.windows.remove(&wid);
                     if let Some(w) = w {
                         let w = w.into_inner();
-                        window_state.client_window_to_window.remove(&w.client_wid);
+                        window_state.client_window_to_window.remove(&w.picom.client_win);
                         drop(window_state);
 
                         // We have to remove window from window_state before handling any
@@ -813,72 +1418,95 @@ impl App {
                 }
             }
         }
+        scheduler.abort();
         Ok(())
     }
     async fn refresh_texture(&self, w: &mut Window) -> Result<bool> {
-        let x11_clone = self.x11.clone();
         let wid = w.id;
-        let win_geometry =
-            block_in_place(|| Result::Ok(x11_clone.as_ref().get_geometry(wid)?.reply()?))?;
-        if let Some((width, height)) = w
-            .textures
-            .as_ref()
-            .map(|ts| (ts.x11_texture.width(), ts.x11_texture.height()))
-        {
-            if width != win_geometry.width as u32 || height != win_geometry.height as u32 {
+        let win_geometry = self.geometry(wid)?;
+        let (width, height) = (win_geometry.width as u32, win_geometry.height as u32);
+        let lod = w.lod.load(Ordering::Relaxed);
+        let (lod_width, lod_height) = lod::size(width, height, lod);
+        let lod_class = (pool::size_class(lod_width), pool::size_class(lod_height));
+        // Texture we can keep using if the window is resized within its size class
+        let mut reusable = None;
+        if let Some((old_width, old_height)) = w.textures.as_ref().map(|ts| (ts.width, ts.height)) {
+            if old_width != width || old_height != height {
                 debug!("Free old textures for {}", wid);
-                TextureSet::free(w.textures.take(), &self.gl, &self.x11).await?;
+                let textures = w.textures.take().unwrap();
+                if let Some(shared) = textures.free_pixmap(&self.gl, &self.x11).await? {
+                    if shared.class == lod_class {
+                        reusable = Some(shared);
+                    } else {
+                        self.recycle_texture(shared).await?;
+                    }
+                }
+            }
+        }
+        if let Some(ts) = w.textures.as_mut().filter(|ts| ts.lod != lod) {
+            // Same pixmap, only the texture it is copied into changes size
+            if let Some(blit) = ts.blit.as_mut() {
+                debug!(
+                    "Level of detail of {} changed from {} to {}",
+                    wid, ts.lod, lod
+                );
+                if blit.shared.class != lod_class {
+                    let shared = self.take_shared_texture(lod_width, lod_height).await?;
+                    let old = std::mem::replace(&mut blit.shared, shared);
+                    ts.remote_texture = blit.shared.remote_texture.clone();
+                    self.recycle_texture(old).await?;
+                }
+                ts.lod = lod;
+                return Ok(true);
             }
         }
 
         if w.textures.is_none() {
-            let (attrs, x11_pixmap) = block_in_place(|| {
-                let attrs = self.x11.get_window_attributes(wid)?.reply()?;
+            let x11_pixmap = block_in_place(|| {
                 let x11_pixmap = self.x11.generate_id()?;
                 self.x11
                     .composite_name_window_pixmap(wid, x11_pixmap)?
                     .check()?;
-                Result::Ok((attrs, x11_pixmap))
+                Result::Ok(x11_pixmap)
             })?;
-            let x11_texture = self.gl.bind_texture(x11_pixmap, attrs.visual).await?;
-
-            let (remote_texture, fd, size) = {
-                let xrd_client = self.xrd_client.lock().await; // Need to keep this alive for gulkan_client
-                let gulkan_client = xrd_client.gulkan().unwrap();
-                let extent = ash::vk::Extent2D {
-                    width: win_geometry.width.into(),
-                    height: win_geometry.height.into(),
-                };
-                let layout = xrd_client.upload_layout();
-
-                let mut size = 0;
-                let mut fd = 0;
-                let remote_texture = unsafe {
-                    glib::translate::from_glib_full(gulkan::sys::gulkan_texture_new_export_fd(
-                        gulkan_client.as_ptr(),
-                        std::mem::transmute(extent),
-                        ash::vk::Format::R8G8B8A8_SRGB.as_raw() as _,
-                        layout,
-                        &mut size,
-                        &mut fd,
-                    ))
-                };
-                (remote_texture, fd, size)
-            };
-            let imported_texture = self
+            if let Some(remote_texture) = self
+                .import_pixmap(x11_pixmap, width, height, w.depth)
+                .await?
+            {
+                debug!("Imported pixmap of {} with DRI3", wid);
+                if let Some(shared) = reusable {
+                    self.recycle_texture(shared).await?;
+                }
+                w.textures = Some(TextureSet {
+                    x11_pixmap,
+                    width,
+                    height,
+                    remote_texture,
+                    blit: None,
+                    lod: 0,
+                });
+                return Ok(true);
+            }
+            // The window pixmap includes the border
+            let border = 2 * win_geometry.border_width as u32;
+            let x11_texture = self
                 .gl
-                .import_fd(
-                    win_geometry.width.into(),
-                    win_geometry.height.into(),
-                    fd,
-                    size as _,
-                )
+                .bind_texture(x11_pixmap, w.visual, width + border, height + border)
                 .await?;
+            let shared = match reusable {
+                Some(shared) => shared,
+                None => self.take_shared_texture(lod_width, lod_height).await?,
+            };
             w.textures = Some(TextureSet {
-                x11_texture,
                 x11_pixmap,
-                remote_texture,
-                imported_texture,
+                width,
+                height,
+                remote_texture: shared.remote_texture.clone(),
+                blit: Some(GlBlit {
+                    x11_texture,
+                    shared,
+                }),
+                lod,
             });
             Ok(true)
         } else {
@@ -886,45 +1514,358 @@ impl App {
         }
     }
 
-    async fn render_win(&self, w: &mut Window) -> Result<()> {
-        if !w.xrd_window.get_mut().is_visible() {
-            return Ok(());
+    /// Get a texture to copy a `width` x `height` window into, from the pool if possible.
+    async fn take_shared_texture(&self, width: u32, height: u32) -> Result<SharedTexture> {
+        let (class_width, class_height) =
+            match self.texture_pool.lock().unwrap().take(width, height) {
+                Ok(shared) => return Ok(shared),
+                Err(class) => class,
+            };
+        {
+            let pool = self.texture_pool.lock().unwrap();
+            debug!(
+                "Texture pool miss for {}x{}, allocating {}x{}. hits: {}, misses: {}",
+                width,
+                height,
+                class_width,
+                class_height,
+                pool.hits(),
+                pool.misses()
+            );
         }
 
-        #[cfg(debug_assertions)]
-        self.gl.capture(true).await?;
-
-        let refreshed = self.refresh_texture(w).await?;
-        let textures = w.textures.as_ref().unwrap();
-        self.gl
-            .blit(&textures.x11_texture, &textures.imported_texture)
+        let (remote_texture, fd, size) = {
+            let xrd_client = self.xrd_client.lock().await; // Need to keep this alive for gulkan_client
+            let gulkan_client = xrd_client.gulkan().unwrap();
+            let extent = ash::vk::Extent2D {
+                width: class_width,
+                height: class_height,
+            };
+            let layout = xrd_client.upload_layout();
+
+            let mut size = 0;
+            let mut fd = 0;
+            let remote_texture = unsafe {
+                glib::translate::from_glib_full(gulkan::sys::gulkan_texture_new_export_fd(
+                    gulkan_client.as_ptr(),
+                    std::mem::transmute(extent),
+                    ash::vk::Format::R8G8B8A8_SRGB.as_raw() as _,
+                    layout,
+                    &mut size,
+                    &mut fd,
+                ))
+            };
+            (remote_texture, fd, size)
+        };
+        let imported_texture = self
+            .gl
+            .import_fd(class_width, class_height, fd, size as _)
             .await?;
+        let semaphore = if self.gl.has_semaphore_fd() {
+            self.create_semaphore().await
+        } else {
+            None
+        };
+        Ok(SharedTexture {
+            remote_texture,
+            imported_texture,
+            semaphore,
+            class: (class_width, class_height),
+        })
+    }
 
-        #[cfg(debug_assertions)]
-        self.gl.capture(false).await?;
+    /// Give a texture no longer used by any window back to the pool.
+    async fn recycle_texture(&self, shared: SharedTexture) -> Result<()> {
+        let evicted = self.texture_pool.lock().unwrap().put(shared.class, shared);
+        if let Some(evicted) = evicted {
+            evicted.free(&self.gl).await?;
+        }
+        Ok(())
+    }
+
+    /// Import the window pixmap into Vulkan as is, so it doesn't need to be copied. Returns None
+    /// if that is not possible.
+    ///
+    /// Only done for pixmaps with an alpha channel. xrdesktop submits the texture to the overlay
+    /// as is, and the alpha channel of depth 24 pixmaps is undefined.
+    async fn import_pixmap(
+        &self,
+        pixmap: xproto::Pixmap,
+        width: u32,
+        height: u32,
+        depth: u8,
+    ) -> Result<Option<gulkan::Texture>> {
+        use std::os::unix::io::AsRawFd;
+        /// Buffer layout is unknown, BuffersFromPixmap returns this for buffers allocated
+        /// without a modifier.
+        const DRM_FORMAT_MOD_INVALID: u64 = 0x00ff_ffff_ffff_ffff;
+        if !self.has_dri3 || depth != 32 {
+            return Ok(None);
+        }
+        let buffers =
+            block_in_place(|| Result::Ok(self.x11.dri3_buffers_from_pixmap(pixmap)?.reply()?))?;
+        if buffers.modifier == DRM_FORMAT_MOD_INVALID
+            || buffers.bpp != 32
+            || buffers.width as u32 != width
+            || buffers.height as u32 != height
+        {
+            return Ok(None);
+        }
+        let fds: Vec<_> = buffers.buffers.iter().map(|fd| fd.as_raw_fd()).collect();
+        let xrd_client = self.xrd_client.lock().await;
+        let gulkan_client = xrd_client.gulkan().unwrap();
+        let extent = ash::vk::Extent2D { width, height };
+        // Window pixmaps are ARGB8888, which is BGRA in memory. Bytes are interpreted as sRGB,
+        // same as after the GL blit. Importing also acquires the texture, which submits to the
+        // graphics queue and can block.
+        let texture = block_in_place(|| unsafe {
+            gulkan::sys::gulkan_texture_new_from_dmabuf_planes(
+                gulkan_client.as_ptr(),
+                fds.len() as _,
+                fds.as_ptr(),
+                buffers.offsets.as_ptr(),
+                buffers.strides.as_ptr(),
+                buffers.modifier,
+                std::mem::transmute(extent),
+                ash::vk::Format::B8G8R8A8_SRGB.as_raw() as _,
+                xrd_client.upload_layout() as _,
+            )
+        });
+        // gulkan dups the fd it needs, `buffers` can be closed now
+        Ok((!texture.is_null()).then(|| unsafe { glib::translate::from_glib_full(texture) }))
+    }
+
+    /// Create a semaphore shared between Vulkan and GL. Returns None if that failed, in which case
+    /// we fallback to synchronizing with glFinish.
+    async fn create_semaphore(&self) -> Option<Semaphore> {
+        let (gulkan, vk, fd, layout) = {
+            let xrd_client = self.xrd_client.lock().await;
+            let gulkan = xrd_client.gulkan().unwrap();
+            let mut fd = -1;
+            let vk: ash::vk::Semaphore = unsafe {
+                std::mem::transmute(gulkan::sys::gulkan_device_create_semaphore_export_fd(
+                    gulkan::sys::gulkan_client_get_device(gulkan.as_ptr()),
+                    &mut fd,
+                ))
+            };
+            let layout = ash::vk::ImageLayout::from_raw(xrd_client.upload_layout() as _);
+            (gulkan, vk, fd, layout)
+        };
+        if vk == ash::vk::Semaphore::null() {
+            return None;
+        }
+        match self.gl.import_semaphore(fd).await {
+            Ok(gl) => Some(Semaphore {
+                gulkan,
+                vk,
+                gl,
+                layout,
+                last_wait: AtomicU64::new(0),
+            }),
+            Err(e) => {
+                warn!("Failed to import semaphore into GL, {}", e);
+                block_in_place(|| Semaphore::destroy_vk(&gulkan, vk, 0));
+                None
+            }
+        }
+    }
 
-        let xrd_window = w.xrd_window.get_mut();
-        if refreshed {
-            xrd_window.set_and_submit_texture(textures.remote_texture.clone());
+    /// Copy the damaged parts of the windows into the textures shared with xrdesktop, and submit
+    /// them. The copies are all done in one batch on the GL thread. A damage list of `None` means
+    /// the whole window needs to be copied.
+    ///
+    /// A window failing doesn't stop the others from being rendered, the first error is returned.
+    async fn render_wins(
+        &self,
+        windows: &mut [(&mut Window, Option<Vec<xproto::Rectangle>>)],
+    ) -> Result<()> {
+        let mut first_error = None;
+        // Index into `windows`, and whether its textures were recreated
+        let mut ready = Vec::with_capacity(windows.len());
+        for (i, (w, damaged)) in windows.iter_mut().enumerate() {
+            if !w.xrd_window.get_mut().is_visible() {
+                continue;
+            }
+            match self.refresh_texture(w).await {
+                Ok(refreshed) => {
+                    // Newly created textures have no content yet, they have to be filled completely.
+                    if refreshed {
+                        *damaged = None;
+                    }
+                    ready.push((i, refreshed));
+                }
+                Err(e) => {
+                    first_error.get_or_insert(e);
+                }
+            }
+        }
+
+        #[cfg(debug_assertions)]
+        self.gl.capture(true)?;
+
+        // Imported pixmaps are shared with X, nothing to copy.
+        let semaphores: Vec<_> = ready
+            .iter()
+            .filter_map(|&(i, _)| {
+                let blit = windows[i].0.textures.as_ref().unwrap().blit.as_ref()?;
+                Some((i, blit.shared.semaphore.as_ref()?))
+            })
+            .collect();
+        let jobs: Vec<_> = ready
+            .iter()
+            .filter_map(|&(i, _)| {
+                let (w, damaged) = &windows[i];
+                let textures = w.textures.as_ref().unwrap();
+                let blit = textures.blit.as_ref()?;
+                Some(gl::BlitJob {
+                    src: &blit.x11_texture,
+                    dst: &blit.shared.imported_texture,
+                    rects: damaged.as_deref(),
+                    lod: textures.lod,
+                    signal: blit.shared.semaphore.as_ref().map(|s| (&s.gl, s.layout)),
+                })
+            })
+            .collect();
+        let blitted = if jobs.is_empty() {
+            Ok(())
         } else {
-            xrd_window.submit_texture();
+            self.gl.blit_batch(&jobs).await
+        };
+        drop(jobs);
+        // Without the GL thread nothing was signaled, and nothing else can be rendered either.
+        if let Err(gl::Error::Remote(_)) = &blitted {
+            return blitted.map_err(Into::into);
         }
-        Ok(())
+        // Every semaphore was signaled, even if a copy failed, and has to be waited on before GL
+        // can signal it again. Make the queue xrdesktop submits textures from wait for the blits
+        // on the GPU.
+        let mut unwaited = Vec::new();
+        if !semaphores.is_empty() {
+            let _xrd_client = self.xrd_client.lock().await;
+            for (i, semaphore) in semaphores {
+                let serial = unsafe {
+                    let device = gulkan::sys::gulkan_client_get_device(semaphore.gulkan.as_ptr());
+                    gulkan::sys::gulkan_queue_wait_semaphore(
+                        gulkan::sys::gulkan_device_get_graphics_queue(device),
+                        std::mem::transmute(semaphore.vk),
+                        ash::vk::PipelineStageFlags::ALL_COMMANDS.as_raw() as _,
+                    )
+                };
+                if serial == 0 {
+                    unwaited.push(i);
+                } else {
+                    semaphore.last_wait.store(serial, Ordering::Relaxed);
+                }
+            }
+        }
+        if let Err(e) = blitted {
+            first_error.get_or_insert(e.into());
+        }
+        // A semaphore nothing waits on stays signaled, so it is replaced. Its blit isn't ordered
+        // before xrdesktop samples the texture, so that window is not submitted this time.
+        for &i in &unwaited {
+            let textures = windows[i].0.textures.as_mut().unwrap();
+            let shared = &mut textures.blit.as_mut().unwrap().shared;
+            let semaphore = shared.semaphore.take().unwrap();
+            if let Err(e) = semaphore.free_unwaited(&self.gl).await {
+                first_error.get_or_insert(e);
+            }
+            shared.semaphore = self.create_semaphore().await;
+            first_error.get_or_insert(anyhow!("Failed to wait for the blit semaphore"));
+        }
+        ready.retain(|(i, _)| !unwaited.contains(i));
+
+        #[cfg(debug_assertions)]
+        self.gl.capture(false)?;
+
+        // X keeps rendering into imported pixmaps, they have to be acquired again before xrdesktop
+        // samples them. Freshly imported ones already are.
+        let imported: Vec<_> = ready
+            .iter()
+            .filter(|&&(i, refreshed)| {
+                !refreshed && windows[i].0.textures.as_ref().unwrap().blit.is_none()
+            })
+            .map(|&(i, _)| i)
+            .collect();
+        if !imported.is_empty() {
+            let xrd_client = self.xrd_client.lock().await;
+            let layout = xrd_client.upload_layout();
+            let mut textures: Vec<_> = imported
+                .iter()
+                .map(|&i| {
+                    let textures = windows[i].0.textures.as_ref().unwrap();
+                    textures.remote_texture.as_ptr()
+                })
+                .collect();
+            // All in one submission. It can block on the previous frame's acquisition.
+            let acquired = block_in_place(|| unsafe {
+                gulkan::sys::gulkan_texture_acquire_foreign_batch(
+                    textures.as_mut_ptr(),
+                    textures.len() as _,
+                    layout as _,
+                )
+            });
+            if acquired == 0 {
+                first_error.get_or_insert(anyhow!("Failed to acquire imported pixmaps"));
+            }
+        }
+
+        for (i, refreshed) in ready {
+            let w = &mut windows[i].0;
+            let textures = w.textures.as_ref().unwrap();
+            let xrd_window = w.xrd_window.get_mut();
+            if refreshed {
+                // Pooled textures can be bigger than the window, and the window can be downscaled
+                // into it.
+                unsafe {
+                    xrd::sys::xrd_window_set_and_submit_texture_region(
+                        xrd_window.as_ptr(),
+                        textures.remote_texture.clone().into_glib_ptr(),
+                        textures.width,
+                        textures.height,
+                        textures.lod,
+                    )
+                };
+            } else {
+                xrd_window.submit_texture();
+            }
+            self.uploaded_updates.fetch_add(1, Ordering::Relaxed);
+        }
+        first_error.map_or(Ok(()), Err)
     }
 
-    async fn map_win_impl(&self, wid: u32) -> Result<()> {
+    /// Returns whether the window was added.
+    async fn map_win_impl(&self, wid: u32) -> Result<bool> {
+        // Send the X requests first and only wait for the replies after the D-Bus properties are
+        // in, so admission takes one round-trip to each server instead of one per request.
+        let (transient_for_cookie, event_mask_cookie, geometry_cookie) = block_in_place(|| {
+            Result::Ok((
+                self.x11.get_property(
+                    false,
+                    wid,
+                    self.atoms.WM_TRANSIENT_FOR,
+                    xproto::AtomEnum::WINDOW,
+                    0,
+                    1,
+                )?,
+                // Select StructureNotify before querying the geometry, so ConfigureNotify keeps
+                // the cache up to date from here on. FocusChange feeds the refresh governor.
+                self.x11.change_window_attributes(
+                    wid,
+                    &xproto::ChangeWindowAttributesAux::new().event_mask(
+                        xproto::EventMask::STRUCTURE_NOTIFY | xproto::EventMask::FOCUS_CHANGE,
+                    ),
+                )?,
+                self.x11.get_geometry(wid)?,
+            ))
+        })?;
         let picom_service = format!("com.github.chjj.compton.{}", self.display);
-        let proxy = picom::WindowProxy::builder(&self.dbus)
-            .destination(picom_service)?
-            .path(format!("{}/{}/{}", PICOM_OBJECT_PATH, "windows", wid))
-            .map(|pb| pb.cache_properties(zbus::CacheProperties::No))?
-            .build()
-            .await?;
-        debug!("Dbus connected {}", wid);
-        if !proxy.mapped().await? {
-            return Ok(());
+        let properties = picom::WindowProperties::get_all(&self.dbus, &picom_service, wid).await?;
+        // Dropping the cookies discards the replies
+        if !properties.mapped {
+            return Ok(false);
         }
-        let ty = proxy.type_().await?;
+        let ty = &properties.type_;
         debug!("window {} is {}", wid, ty);
         if ty != "normal"
             && ty != "menu"
@@ -932,35 +1873,23 @@ impl App {
             && ty != "dropdown_menu"
             && ty != "utility"
         {
-            return Ok(());
+            return Ok(false);
         }
-        let window_name = proxy.name().await?;
-        let client_wid = proxy.client_win().await?;
-        let transient_for = block_in_place(|| {
-            Result::Ok(
-                self.x11
-                    .get_property(
-                        false,
-                        wid,
-                        self.atoms.WM_TRANSIENT_FOR,
-                        xproto::AtomEnum::WINDOW,
-                        0,
-                        1,
-                    )?
-                    .reply()?,
-            )
-        })?
-        .value32()
-        .and_then(|mut w| w.next());
+        let (transient_for, win_reply) = block_in_place(|| {
+            event_mask_cookie.check()?;
+            Result::Ok((transient_for_cookie.reply()?, geometry_cookie.reply()?))
+        })?;
+        let transient_for = transient_for.value32().and_then(|mut w| w.next());
         debug!("transient for of {} is {:?}", wid, transient_for);
-        // TODO: cache root geometry
         let root_win = self.x11.setup().roots[self.screen as usize].root;
-        let (root_geometry, win_geometry) = block_in_place(|| {
-            Result::Ok((
-                self.x11.get_geometry(root_win)?.reply()?,
-                self.x11.get_geometry(wid)?.reply()?,
-            ))
-        })?;
+        let root_geometry = self.geometry(root_win)?;
+        // A ConfigureNotify could have been handled already, it is at least as new as the reply.
+        let win_geometry = *self
+            .geometries
+            .lock()
+            .unwrap()
+            .entry(wid)
+            .or_insert_with(|| Geometry::from_reply(&win_reply));
         if win_geometry.x <= -(win_geometry.width as i16)
             || win_geometry.y <= -(win_geometry.height as i16)
             || win_geometry.x >= root_geometry.width as _
@@ -968,14 +1897,14 @@ impl App {
         {
             // If the window is entirely outside of the screen, hide it
             // Firefox does this and has a 1x1 window outside the screen
-            return Ok(());
+            return Ok(false);
         }
 
         let xrd_window = {
             let xrd_client = self.xrd_client.lock().await;
             let xrd_window = xrd::Window::new_from_pixels(
                 &*xrd_client,
-                &window_name,
+                &properties.name,
                 win_geometry.width.into(),
                 win_geometry.height.into(),
                 PIXELS_PER_METER,
@@ -1036,8 +1965,7 @@ impl App {
             drop(xrd_client);
             if let Some(parent) = parent {
                 let parent = parent.read().await;
-                let parent_geometry =
-                    block_in_place(|| Result::Ok(self.x11.get_geometry(parent.id)?.reply()?))?;
+                let parent_geometry = self.geometry(parent.id)?;
                 let (parent_center_x, parent_center_y) = (
                     parent_geometry.x + parent_geometry.width as i16 / 2,
                     parent_geometry.y + parent_geometry.height as i16 / 2,
@@ -1066,14 +1994,21 @@ impl App {
         debug!("position set");
 
         let damage = self.x11.generate_id()?;
+        let damage_region = self.x11.generate_id()?;
         let x11_clone = self.x11.clone();
         {
             let mut window_state = self.window_state.write().await;
             let win_attrs = block_in_place(move || {
-                x11_clone
-                    .damage_create(damage, wid, x11rb::protocol::damage::ReportLevel::NON_EMPTY)?
-                    .check()?;
-                Result::Ok(x11_clone.get_window_attributes(wid)?.reply()?)
+                let cookie1 = x11_clone.damage_create(
+                    damage,
+                    wid,
+                    x11rb::protocol::damage::ReportLevel::NON_EMPTY,
+                )?;
+                let cookie2 = x11_clone.xfixes_create_region(damage_region, &[])?;
+                let cookie3 = x11_clone.get_window_attributes(wid)?;
+                cookie1.check()?;
+                cookie2.check()?;
+                Result::Ok(cookie3.reply()?)
             })?;
 
             // If we receive map -> unmap -> map event of the same window in quick
@@ -1090,22 +2025,36 @@ impl App {
             // replace the existing window.
             if win_attrs.map_state != xproto::MapState::VIEWABLE {
                 debug!("Window {wid:#010x} not viewable, giving up");
-                return Ok(());
+                self.x11.damage_destroy(damage)?.ignore_error();
+                self.x11
+                    .xfixes_destroy_region(damage_region)?
+                    .ignore_error();
+                return Ok(false);
             }
 
             let xrd_window = Mutex::new(xrd_window);
             let window = Window {
                 id: wid,
-                name: window_name,
                 gl: self.gl.clone(),
                 damage,
+                damage_region,
                 x11: self.x11.clone(),
                 xrd: self.xrd_client.clone(),
                 textures: None,
                 xrd_window,
-                client_wid,
+                texture_pool: self.texture_pool.clone(),
+                picom: properties,
+                visual: win_attrs.visual,
+                depth: win_reply.depth,
+                dirty: AtomicBool::new(false),
+                lod: AtomicU32::new(0),
+                last_rendered: None,
+                culled: false,
+                deferred: false,
+                deferred_until: None,
                 drop_bomb: DropBomb::new("Window dropped unsafely"),
             };
+            let client_wid = window.picom.client_win;
             let parent_wid = window_state.client_window_to_window.insert(client_wid, wid);
             if let Some(parent_wid) = parent_wid {
                 if parent_wid != wid {
@@ -1130,47 +2079,49 @@ impl App {
                 }
             };
             let mut window = window.write().await;
-            self.render_win(&mut window).await?;
+            self.render_wins(&mut [(&mut window, None)]).await?;
         }
         info!("Added new window {:#010x}", wid);
         //remove ourself from pending_windows
-        Ok(())
+        Ok(true)
     }
 
     async fn map_win(&self, wid: u32) -> Result<()> {
+        let start = std::time::Instant::now();
         let result = self.map_win_impl(wid).await;
         self.pending_windows.lock().await.remove(&wid);
-        result
+        if let Ok(true) = result {
+            self.map_latency.lock().unwrap().record(start.elapsed());
+        }
+        result.map(|_| ())
     }
 
     async fn setup_initial_windows(self: &Arc<Self>) -> Result<()> {
         let picom_service = format!("com.github.chjj.compton.{}", self.display);
-        let proxy: zbus::Proxy<'_> = zbus::ProxyBuilder::new_bare(&self.dbus)
+        let proxy = picom::PicomProxy::builder(&self.dbus)
             .destination(picom_service)?
-            .interface("what.ever")?
-            .path(format!("{}/{}", PICOM_OBJECT_PATH, "windows"))?
             .build()
             .await?;
 
-        let windows = zbus::xml::Node::from_reader(proxy.introspect().await?.as_bytes())?;
-        let futs: futures::stream::FuturesUnordered<_> = windows
-            .nodes()
+        let futs: futures::stream::FuturesUnordered<_> = proxy
+            .list_win()
+            .await?
             .into_iter()
-            .map(|w| {
+            .map(|wid| {
                 let self_clone = self.clone();
-                let wid = w.name().unwrap().to_owned();
                 tokio::spawn(async move {
-                    if let Ok(wid) = parse_int::parse(&wid) {
-                        if let Err(e) = self_clone.map_win(wid).await {
-                            info!("Failed to map window {}, {}", wid, e);
-                        }
-                    } else {
-                        error!("Invalid window id from picom: {}", wid);
+                    if let Err(e) = self_clone.map_win(wid).await {
+                        info!("Failed to map window {}, {}", wid, e);
                     }
                 })
             })
             .collect();
-        Ok(futs.try_collect().await?)
+        futs.try_collect().await?;
+        info!(
+            "Initial windows mapped: {}",
+            self.map_latency.lock().unwrap()
+        );
+        Ok(())
     }
 }
 
@@ -11,6 +11,9 @@ trait Picom {
 
     /// reset method
     fn reset(&self) -> zbus::Result<()>;
+
+    /// list_win method
+    fn list_win(&self) -> zbus::Result<Vec<u32>>;
 }
 
 #[dbus_proxy(
@@ -35,37 +38,50 @@ trait Compositor {
     fn win_unmapped(&self, wid: u32) -> zbus::Result<()>;
 }
 
-#[dbus_proxy(interface = "picom.Window", assume_defaults = false)]
-trait Window {
-    /// ClientWin property
-    #[dbus_proxy(property)]
-    fn client_win(&self) -> zbus::Result<u32>;
-
-    /// Id property
-    #[dbus_proxy(property)]
-    fn id(&self) -> zbus::Result<u32>;
-
-    /// Leader property
-    #[dbus_proxy(property)]
-    fn leader(&self) -> zbus::Result<u32>;
-
-    /// Mapped property
-    #[dbus_proxy(property)]
-    fn mapped(&self) -> zbus::Result<bool>;
-
-    /// Name property
-    #[dbus_proxy(property)]
-    fn name(&self) -> zbus::Result<String>;
-
-    /// Next property
-    #[dbus_proxy(property)]
-    fn next(&self) -> zbus::Result<u32>;
-
-    /// RawFocused property
-    #[dbus_proxy(property)]
-    fn raw_focused(&self) -> zbus::Result<bool>;
+/// Properties of the `picom.Window` interface, fetched with a single `GetAll` call instead of
+/// one call per property.
+#[derive(Debug, Clone)]
+pub struct WindowProperties {
+    pub client_win: u32,
+    pub mapped: bool,
+    pub name: String,
+    pub type_: String,
+}
 
-    /// Type property
-    #[dbus_proxy(property)]
-    fn type_(&self) -> zbus::Result<String>;
+impl WindowProperties {
+    pub async fn get_all(
+        connection: &zbus::Connection,
+        destination: &str,
+        wid: u32,
+    ) -> anyhow::Result<Self> {
+        use anyhow::Context;
+        use zbus::zvariant::OwnedValue;
+        // Every window is its own object, so a proxy would have to be built per window. Calling
+        // the method on the connection directly skips that.
+        let reply = connection
+            .call_method(
+                Some(destination),
+                format!("{}/windows/{}", crate::PICOM_OBJECT_PATH, wid).as_str(),
+                Some("org.freedesktop.DBus.Properties"),
+                "GetAll",
+                &("picom.Window",),
+            )
+            .await?;
+        let mut properties: std::collections::HashMap<String, OwnedValue> = reply.body()?;
+        fn take<T: TryFrom<OwnedValue>>(
+            properties: &mut std::collections::HashMap<String, OwnedValue>,
+            name: &str,
+        ) -> anyhow::Result<T> {
+            properties
+                .remove(name)
+                .and_then(|value| T::try_from(value).ok())
+                .with_context(|| anyhow::anyhow!("Missing or invalid property {}", name))
+        }
+        Ok(Self {
+            client_win: take(&mut properties, "ClientWin")?,
+            mapped: take(&mut properties, "Mapped")?,
+            name: take(&mut properties, "Name")?,
+            type_: take(&mut properties, "Type")?,
+        })
+    }
 }
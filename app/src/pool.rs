@@ -0,0 +1,67 @@
+//! Pool of textures bucketed by size class, so resized windows, and windows that come and go
+//! quickly like menus and tooltips, can reuse textures instead of allocating new ones.
+
+use std::collections::HashMap;
+
+/// Round `v` up to its size class. Classes are 1/8 of the next power of two apart, so at most
+/// ~1/8 of a texture is wasted in each dimension.
+pub fn size_class(v: u32) -> u32 {
+    let granularity = (v.next_power_of_two() / 8).max(32);
+    (v.max(1) + granularity - 1) / granularity * granularity
+}
+
+#[derive(Debug)]
+pub struct Pool<T> {
+    free: HashMap<(u32, u32), Vec<T>>,
+    len: usize,
+    capacity: usize,
+    hits: u64,
+    misses: u64,
+}
+
+impl<T> Pool<T> {
+    /// Create a pool that keeps at most `capacity` unused textures.
+    pub fn new(capacity: usize) -> Self {
+        Self {
+            free: Default::default(),
+            len: 0,
+            capacity,
+            hits: 0,
+            misses: 0,
+        }
+    }
+    /// Take a texture big enough for `width` x `height`. On a miss, returns the size the caller
+    /// should allocate instead.
+    pub fn take(&mut self, width: u32, height: u32) -> Result<T, (u32, u32)> {
+        let class = (size_class(width), size_class(height));
+        if let Some(texture) = self.free.get_mut(&class).and_then(Vec::pop) {
+            self.len -= 1;
+            self.hits += 1;
+            Ok(texture)
+        } else {
+            self.misses += 1;
+            Err(class)
+        }
+    }
+    /// Return a texture of size `class` to the pool. If the pool is full, the texture is given
+    /// back and has to be freed by the caller.
+    pub fn put(&mut self, class: (u32, u32), texture: T) -> Option<T> {
+        if self.len >= self.capacity {
+            return Some(texture);
+        }
+        self.len += 1;
+        self.free.entry(class).or_default().push(texture);
+        None
+    }
+    /// Remove all unused textures from the pool
+    pub fn drain(&mut self) -> impl Iterator<Item = T> + '_ {
+        self.len = 0;
+        self.free.drain().flat_map(|(_, textures)| textures)
+    }
+    pub fn hits(&self) -> u64 {
+        self.hits
+    }
+    pub fn misses(&self) -> u64 {
+        self.misses
+    }
+}
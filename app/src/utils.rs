@@ -1,3 +1,7 @@
+use std::sync::{
+    atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering},
+    Arc,
+};
 use tokio::sync::{
     mpsc::{unbounded_channel, UnboundedReceiver, UnboundedSender},
     oneshot::{channel as oneshot_channel, error as oneshot_error, Receiver, Sender},
@@ -8,13 +12,28 @@ pub enum Error {
     OneshotRecv(#[from] oneshot_error::RecvError),
     #[error("Failed to send request to thread")]
     MpscSend,
+    #[error("Thread exited before handling the request")]
+    Closed,
 }
 
 type Result<T, E = Error> = std::result::Result<T, E>;
 
 use std::any::Any;
 type Closure<T> = Box<dyn FnOnce(&mut T) -> Box<dyn Any + Send> + Send>;
-struct Request<T>(Closure<T>, Sender<Box<dyn Any + Send>>);
+
+/// Requests sent by value, without the boxed closure and type-erased reply of `Remote::call`,
+/// and handled in order with those closures. Commands whose result is needed carry their own
+/// typed reply channel.
+pub trait Commands {
+    type Command: Send + 'static;
+    /// Nobody is waiting for the result, so errors have to be reported here.
+    fn handle(&mut self, command: Self::Command);
+}
+
+enum Request<T: Commands> {
+    Call(Closure<T>, Sender<Box<dyn Any + Send>>),
+    Command(T::Command),
+}
 
 // feature: downcast_unchecked
 trait UnsafeAny<T> {
@@ -27,43 +46,110 @@ impl<T: Any> UnsafeAny<T> for Box<dyn Any> {
     }
 }
 
-struct RemoteInner<T>(T, UnboundedReceiver<Request<T>>);
-impl<T> RemoteInner<T> {
+/// Counts the requests sent to and handled by the remote thread, so callers can wait for
+/// commands without a reply channel per request. Handling a request only bumps a counter, the
+/// condvar's lock is only taken while a thread is blocked in `wait_sync`.
+#[derive(Default)]
+struct Completion {
+    /// Number of requests sent. Locked while sending so the count matches the queue order.
+    sent: std::sync::Mutex<u64>,
+    completed: AtomicU64,
+    /// Set once the thread stops handling requests, after the last one was completed
+    closed: AtomicBool,
+    /// Number of threads in `wait_sync`, nobody else needs the condvar
+    sync_waiters: AtomicUsize,
+    lock: std::sync::Mutex<()>,
+    condvar: std::sync::Condvar,
+    notify: tokio::sync::Notify,
+}
+
+impl Completion {
+    fn complete(&self) {
+        self.completed.fetch_add(1, Ordering::SeqCst);
+        self.wake();
+    }
+    fn close(&self) {
+        self.closed.store(true, Ordering::SeqCst);
+        self.wake();
+    }
+    fn wake(&self) {
+        if self.sync_waiters.load(Ordering::SeqCst) > 0 {
+            // A waiter holds the lock from its check until it sleeps, so it can't miss this
+            drop(self.lock.lock().unwrap_or_else(|e| e.into_inner()));
+            self.condvar.notify_all();
+        }
+        self.notify.notify_waiters();
+    }
+    /// Whether the request with `ticket` is handled, or an error if it never will be.
+    fn is_completed(&self, ticket: u64) -> Result<bool> {
+        // Read first, nothing completes after it is set
+        let closed = self.closed.load(Ordering::SeqCst);
+        if self.completed.load(Ordering::SeqCst) >= ticket {
+            Ok(true)
+        } else if closed {
+            Err(Error::Closed)
+        } else {
+            Ok(false)
+        }
+    }
+}
+
+/// Closes the `Completion` when the thread stops, including when a request panics, so waiters
+/// don't hang.
+struct CloseOnDrop<'a>(&'a Completion);
+impl Drop for CloseOnDrop<'_> {
+    fn drop(&mut self) {
+        self.0.close();
+    }
+}
+
+struct RemoteInner<T: Commands>(T, UnboundedReceiver<Request<T>>, Arc<Completion>);
+impl<T: Commands> RemoteInner<T> {
     fn new<E>(
         f: impl FnOnce() -> Result<T, E>,
         rx: UnboundedReceiver<Request<T>>,
+        completion: Arc<Completion>,
     ) -> Result<Self, E> {
-        Ok(Self(f()?, rx))
+        Ok(Self(f()?, rx, completion))
     }
     fn run(&mut self) {
+        let _close = CloseOnDrop(&self.2);
         while let Some(req) = self.1.blocking_recv() {
-            let _: Result<_, _> = req.1.send((req.0)(&mut self.0));
+            match req {
+                Request::Call(f, tx) => {
+                    let _: Result<_, _> = tx.send(f(&mut self.0));
+                }
+                Request::Command(command) => self.0.handle(command),
+            }
+            self.2.complete();
         }
     }
 }
 
-pub struct Remote<T>(UnboundedSender<Request<T>>);
+pub struct Remote<T: Commands>(UnboundedSender<Request<T>>, Arc<Completion>);
 
-impl<T> Clone for Remote<T> {
+impl<T: Commands> Clone for Remote<T> {
     fn clone(&self) -> Self {
-        Self(self.0.clone())
+        Self(self.0.clone(), self.1.clone())
     }
 }
 
-impl<T> std::fmt::Debug for Remote<T> {
+impl<T: Commands> std::fmt::Debug for Remote<T> {
     fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
         self.0.fmt(f)
     }
 }
 
-impl<T: 'static> Remote<T> {
+impl<T: Commands + 'static> Remote<T> {
     pub async fn new<E: Send + std::fmt::Debug + 'static>(
         f: impl FnOnce() -> Result<T, E> + Send + 'static,
     ) -> Result<Self, E> {
         let (tx, rx) = unbounded_channel();
         let (init_tx, init_rx) = oneshot_channel();
+        let completion = Arc::new(Completion::default());
+        let completion_clone = completion.clone();
         std::thread::spawn(move || {
-            let inner = RemoteInner::new(f, rx);
+            let inner = RemoteInner::new(f, rx, completion_clone);
             match inner {
                 Ok(mut inner) => {
                     init_tx.send(Ok(())).unwrap();
@@ -75,7 +161,52 @@ impl<T: 'static> Remote<T> {
             }
         });
         init_rx.await.unwrap()?;
-        Ok(Self(tx))
+        Ok(Self(tx, completion))
+    }
+    /// Queue a request, returns the ticket to pass to `wait`.
+    fn send_request(&self, request: Request<T>) -> Result<u64> {
+        let mut sent = self.1.sent.lock().unwrap();
+        self.0.send(request).map_err(|_| Error::MpscSend)?;
+        *sent += 1;
+        Ok(*sent)
+    }
+    /// Send a command without waiting for it to be handled.
+    pub fn send(&self, command: T::Command) -> Result<u64> {
+        self.send_request(Request::Command(command))
+    }
+    /// Wait until the request with `ticket`, and everything sent before it, is handled. Fails if
+    /// the thread exited before that.
+    pub async fn wait(&self, ticket: u64) -> Result<()> {
+        loop {
+            let notified = self.1.notify.notified();
+            if self.1.is_completed(ticket)? {
+                return Ok(());
+            }
+            notified.await;
+        }
+    }
+    pub fn wait_sync(&self, ticket: u64) -> Result<()> {
+        let completion = &self.1;
+        completion.sync_waiters.fetch_add(1, Ordering::SeqCst);
+        let lock = completion.lock.lock().unwrap();
+        let lock = completion
+            .condvar
+            .wait_while(lock, |_| {
+                matches!(completion.is_completed(ticket), Ok(false))
+            })
+            .unwrap();
+        drop(lock);
+        completion.sync_waiters.fetch_sub(1, Ordering::SeqCst);
+        completion.is_completed(ticket).map(drop)
+    }
+    /// Wait until everything sent so far is handled.
+    pub async fn flush(&self) -> Result<()> {
+        let ticket = *self.1.sent.lock().unwrap();
+        self.wait(ticket).await
+    }
+    pub fn flush_sync(&self) -> Result<()> {
+        let ticket = *self.1.sent.lock().unwrap();
+        self.wait_sync(ticket)
     }
     fn call_inner<R: 'static + Send>(
         &self,
@@ -84,9 +215,7 @@ impl<T: 'static> Remote<T> {
         let boxed = Box::new(|v: &mut T| Box::new(f(v)) as Box<dyn Any + Send>)
             as Box<dyn FnOnce(&mut T) -> Box<dyn Any + Send> + Send>;
         let (tx, rx) = oneshot_channel();
-        self.0
-            .send(Request(boxed, tx))
-            .map_err(|_| Error::MpscSend)?;
+        self.send_request(Request::Call(boxed, tx))?;
         Ok(rx)
     }
     pub async fn call<R: 'static + Send>(
@@ -6,6 +6,7 @@
  */
 
 #include "gulkan-buffer.h"
+#include "gulkan-device-private.h"
 
 #include <vulkan/vulkan.h>
 
@@ -16,7 +17,7 @@ struct _GulkanBuffer
   GulkanDevice *device;
 
   VkBuffer handle;
-  VkDeviceMemory memory;
+  GulkanMemory memory;
 };
 
 G_DEFINE_TYPE (GulkanBuffer, gulkan_buffer, G_TYPE_OBJECT)
@@ -26,6 +27,7 @@ gulkan_buffer_init (GulkanBuffer *self)
 {
   self->handle = VK_NULL_HANDLE;
   self->device = VK_NULL_HANDLE;
+  memset (&self->memory, 0, sizeof (self->memory));
 }
 
 static void
@@ -37,8 +39,7 @@ _finalize (GObject *gobject)
   if (self->handle != VK_NULL_HANDLE)
     vkDestroyBuffer (device, self->handle, NULL);
 
-  if (self->memory != VK_NULL_HANDLE)
-    vkFreeMemory (device, self->memory, NULL);
+  gulkan_device_free_memory (self->device, &self->memory);
   G_OBJECT_CLASS (gulkan_buffer_parent_class)->finalize (gobject);
 }
 
@@ -49,18 +50,6 @@ gulkan_buffer_class_init (GulkanBufferClass *klass)
   object_class->finalize = _finalize;
 }
 
-static VkDeviceSize
-_align_to_non_coherent_atom_size (GulkanBuffer *self,
-                                  VkDeviceSize allocation_size)
-{
-  VkPhysicalDeviceProperties *props =
-    gulkan_device_get_physical_device_properties (self->device);
-  VkDeviceSize atom_size = props->limits.nonCoherentAtomSize;
-
-  VkDeviceSize r = allocation_size % atom_size;
-  return r ? allocation_size + (atom_size - r) : allocation_size;
-}
-
 static gboolean
 _create (GulkanBuffer         *self,
          VkDeviceSize          size,
@@ -87,25 +76,12 @@ _create (GulkanBuffer         *self,
   VkMemoryRequirements requirements;
   vkGetBufferMemoryRequirements (device, self->handle, &requirements);
 
-  VkMemoryAllocateInfo alloc_info = {
-    .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-    .allocationSize = _align_to_non_coherent_atom_size (self, requirements.size)
-  };
-
-  if (!gulkan_device_memory_type_from_properties (
-        self->device,
-        requirements.memoryTypeBits,
-        properties,
-        &alloc_info.memoryTypeIndex))
-  {
-    g_printerr ("Failed to find matching memoryTypeIndex for buffer\n");
+  if (!gulkan_device_allocate_memory (self->device, &requirements,
+                                      properties, TRUE, &self->memory))
     return FALSE;
-  }
-
-  res = vkAllocateMemory (device, &alloc_info, NULL, &self->memory);
-  vk_check_error ("vkAllocateMemory", res, FALSE);
 
-  res = vkBindBufferMemory (device, self->handle, self->memory, 0);
+  res = vkBindBufferMemory (device, self->handle, self->memory.memory,
+                            self->memory.offset);
   vk_check_error ("vkBindBufferMemory", res, FALSE);
 
   return TRUE;
@@ -154,23 +130,28 @@ gulkan_buffer_new_from_data (GulkanDevice         *device,
   return self;
 }
 
+/*
+ * Host visible buffers are persistently mapped, this only returns the
+ * mapping. It stays valid until the buffer is freed.
+ */
 gboolean
 gulkan_buffer_map (GulkanBuffer *self,
                    void        **data)
 {
-  VkDevice device = gulkan_device_get_handle (self->device);
-
-  VkResult res = vkMapMemory (device, self->memory, 0, VK_WHOLE_SIZE, 0, data);
-  vk_check_error ("vkMapMemory", res, FALSE);
+  if (self->memory.data == NULL)
+    {
+      g_printerr ("Trying to map buffer that is not host visible.\n");
+      return FALSE;
+    }
 
+  *data = self->memory.data;
   return TRUE;
 }
 
 void
 gulkan_buffer_unmap (GulkanBuffer *self)
 {
-  VkDevice device = gulkan_device_get_handle (self->device);
-  vkUnmapMemory (device, self->memory);
+  (void) self;
 }
 
 gboolean
@@ -194,8 +175,9 @@ gulkan_buffer_upload (GulkanBuffer  *self,
 
   VkMappedMemoryRange memory_range = {
     .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-    .memory = self->memory,
-    .size = VK_WHOLE_SIZE
+    .memory = self->memory.memory,
+    .offset = self->memory.offset,
+    .size = self->memory.size
   };
   VkResult res = vkFlushMappedMemoryRanges (device, 1, &memory_range);
   vk_check_error ("vkFlushMappedMemoryRanges", res, FALSE);
@@ -214,5 +196,18 @@ gulkan_buffer_get_handle (GulkanBuffer *self)
 VkDeviceMemory
 gulkan_buffer_get_memory_handle (GulkanBuffer *self)
 {
-  return self->memory;
+  return self->memory.memory;
+}
+
+/**
+ * gulkan_buffer_get_memory_offset:
+ * @self: a #GulkanBuffer
+ *
+ * Returns: where the buffer starts in the memory from
+ * gulkan_buffer_get_memory_handle(), which can be shared with other buffers.
+ */
+VkDeviceSize
+gulkan_buffer_get_memory_offset (GulkanBuffer *self)
+{
+  return self->memory.offset;
 }
@@ -52,6 +52,9 @@ gulkan_buffer_get_handle (GulkanBuffer *self);
 VkDeviceMemory
 gulkan_buffer_get_memory_handle (GulkanBuffer *self);
 
+VkDeviceSize
+gulkan_buffer_get_memory_offset (GulkanBuffer *self);
+
 G_END_DECLS
 
 #endif /* GULKAN_BUFFER_H_ */
@@ -171,7 +171,20 @@ gulkan_client_get_external_memory_device_extensions (void)
     VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME,
     VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
     VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
-    VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME
+    VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME,
+#ifdef VK_EXT_image_drm_format_modifier
+    /* Optional, for importing dma-bufs with modifiers */
+    VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME,
+    VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME,
+    VK_KHR_BIND_MEMORY_2_EXTENSION_NAME,
+    VK_KHR_IMAGE_FORMAT_LIST_EXTENSION_NAME,
+    VK_KHR_MAINTENANCE1_EXTENSION_NAME,
+    VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME,
+#endif
+#ifdef VK_EXT_queue_family_foreign
+    /* Optional, for handing imported dma-bufs back and forth */
+    VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME,
+#endif
   };
 
   GSList *device_ext_list = NULL;
@@ -15,8 +15,19 @@ G_BEGIN_DECLS
 
 typedef struct _GulkanQueue GulkanQueue;
 
-GulkanCmdBuffer *gulkan_cmd_buffer_new (GulkanDevice *device,
-                                        GulkanQueue  *queue);
+GulkanCmdBuffer *gulkan_cmd_buffer_new (GulkanDevice  *device,
+                                        GulkanQueue   *queue,
+                                        VkCommandPool  pool,
+                                        gpointer       ring);
+
+gpointer
+gulkan_cmd_buffer_get_ring (GulkanCmdBuffer *self);
+
+void
+gulkan_cmd_buffer_hold (GulkanCmdBuffer *self);
+
+gboolean
+gulkan_cmd_buffer_release (GulkanCmdBuffer *self);
 
 G_END_DECLS
 
@@ -24,6 +24,11 @@ struct _GulkanCmdBuffer
   VkQueue queue;
 
   VkCommandPool pool;
+
+  /* Per-thread ring of the queue the buffer goes back to once unused */
+  gpointer ring;
+  /* The caller that requested the buffer, and the submission it is in */
+  gint users;
 };
 
 G_DEFINE_TYPE (GulkanCmdBuffer, gulkan_cmd_buffer, G_TYPE_OBJECT)
@@ -31,7 +36,8 @@ G_DEFINE_TYPE (GulkanCmdBuffer, gulkan_cmd_buffer, G_TYPE_OBJECT)
 static void
 gulkan_cmd_buffer_init (GulkanCmdBuffer *self)
 {
-  (void) self;
+  self->ring = NULL;
+  self->users = 0;
 }
 
 static GulkanCmdBuffer *
@@ -55,10 +61,13 @@ gulkan_cmd_buffer_class_init (GulkanCmdBufferClass *klass)
   object_class->finalize = _finalize;
 }
 
-GulkanCmdBuffer *gulkan_cmd_buffer_new (GulkanDevice *device,
-                                        GulkanQueue  *queue) {
+GulkanCmdBuffer *gulkan_cmd_buffer_new (GulkanDevice  *device,
+                                        GulkanQueue   *queue,
+                                        VkCommandPool  pool,
+                                        gpointer       ring) {
   GulkanCmdBuffer *self = _new();
-  self->pool = gulkan_queue_get_command_pool (queue);
+  self->pool = pool;
+  self->ring = ring;
   self->device = gulkan_device_get_handle (device);
   self->queue = gulkan_queue_get_handle (queue);
 
@@ -99,3 +108,22 @@ gulkan_cmd_buffer_get_handle (GulkanCmdBuffer *self)
 {
   return self->handle;
 }
+
+gpointer
+gulkan_cmd_buffer_get_ring (GulkanCmdBuffer *self)
+{
+  return self->ring;
+}
+
+void
+gulkan_cmd_buffer_hold (GulkanCmdBuffer *self)
+{
+  g_atomic_int_inc (&self->users);
+}
+
+/* Returns TRUE when the last user is gone and the buffer can be reused */
+gboolean
+gulkan_cmd_buffer_release (GulkanCmdBuffer *self)
+{
+  return g_atomic_int_dec_and_test (&self->users);
+}
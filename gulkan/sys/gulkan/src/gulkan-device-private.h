@@ -0,0 +1,76 @@
+/*
+ * gulkan
+ * Copyright 2020 Collabora Ltd.
+ * Author: Lubosz Sarnecki <lubosz.sarnecki@collabora.com>
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef GULKAN_DEVICE_PRIVATE_H_
+#define GULKAN_DEVICE_PRIVATE_H_
+
+#include "gulkan-device.h"
+#include "gulkan-buffer.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Device memory for one buffer or image, see gulkan_device_allocate_memory().
+ * @block is NULL for dedicated allocations.
+ */
+typedef struct
+{
+  VkDeviceMemory memory;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  void *data;
+  uint32_t type_index;
+  gpointer block;
+} GulkanMemory;
+
+gboolean
+gulkan_device_allocate_memory (GulkanDevice               *self,
+                               const VkMemoryRequirements *requirements,
+                               VkMemoryPropertyFlags       properties,
+                               gboolean                    linear,
+                               GulkanMemory               *memory);
+
+void
+gulkan_device_free_memory (GulkanDevice *self,
+                           GulkanMemory *memory);
+
+/*
+ * Data copied to the device's staging memory, to be used as the source of a
+ * transfer. @region is set when the data is in the staging ring, @dedicated
+ * when it didn't fit and got a buffer of its own.
+ */
+typedef struct
+{
+  VkBuffer buffer;
+  VkDeviceSize offset;
+  gpointer region;
+  GulkanBuffer *dedicated;
+} GulkanStaging;
+
+gboolean
+gulkan_device_stage (GulkanDevice  *self,
+                     const void    *data,
+                     VkDeviceSize   size,
+                     GulkanStaging *staging);
+
+void
+gulkan_device_unstage (GulkanDevice  *self,
+                       GulkanStaging *staging,
+                       GulkanQueue   *queue,
+                       uint64_t       serial);
+
+gboolean
+gulkan_device_import_semaphore_sync_fd (GulkanDevice *self,
+                                        VkSemaphore   semaphore,
+                                        int           fd);
+
+uint32_t
+gulkan_device_get_foreign_queue_family (GulkanDevice *self);
+
+G_END_DECLS
+
+#endif /* GULKAN_DEVICE_PRIVATE_H_ */
@@ -5,9 +5,93 @@
  * SPDX-License-Identifier: MIT
  */
 
-#include "gulkan-device.h"
+#include "gulkan-device-private.h"
 #include "gulkan-queue.h"
 
+/* Allocations are rounded up to a power of two size class between these,
+ * bigger ones get dedicated device memory. */
+#define MIN_SIZE_CLASS_SHIFT 8
+#define MAX_SIZE_CLASS_SHIFT 20
+#define SIZE_CLASS_COUNT (MAX_SIZE_CLASS_SHIFT - MIN_SIZE_CLASS_SHIFT + 1)
+
+/* Size of the device memory blocks that are split into slots */
+#define MEMORY_BLOCK_SIZE (4 * 1024 * 1024)
+
+/* Uploads bigger than half of this get a dedicated staging buffer */
+#define STAGING_RING_SIZE (16 * 1024 * 1024)
+
+/*
+ * One vkAllocateMemory, split into equally sized slots of one size class.
+ * Slot offsets are multiples of the slot size, which is a power of two, so
+ * they satisfy any alignment up to it.
+ */
+typedef struct
+{
+  VkDeviceMemory memory;
+  /* Persistent mapping, NULL if the memory is not host visible */
+  guchar *data;
+  uint32_t type_index;
+  /* The list in GulkanMemoryAllocator the block is in */
+  GSList **slab;
+  VkDeviceSize slot_size;
+  uint32_t slot_count;
+  /* Indices of free slots, the first @free_count are valid */
+  uint32_t *free_slots;
+  uint32_t free_count;
+} GulkanMemoryBlock;
+
+/*
+ * Blocks are kept apart by memory type and by whether they hold linear
+ * resources, buffers and linear images, or optimal images. This way
+ * neighbouring slots never have to respect bufferImageGranularity.
+ */
+typedef struct
+{
+  GMutex mutex;
+  /* Lists of GulkanMemoryBlock, by [linear][type index][size class] */
+  GSList *slabs[2][VK_MAX_MEMORY_TYPES][SIZE_CLASS_COUNT];
+
+  /* Memory allocated from the driver, blocks and dedicated allocations */
+  VkDeviceSize heap_allocated[VK_MAX_MEMORY_HEAPS];
+  /* Memory handed out, including size class rounding */
+  VkDeviceSize heap_used[VK_MAX_MEMORY_HEAPS];
+  uint32_t heap_allocation_count[VK_MAX_MEMORY_HEAPS];
+} GulkanMemoryAllocator;
+
+/*
+ * Part of the staging ring used by one transfer. @queue is NULL until the
+ * transfer is submitted, the region can be reused once @serial is complete.
+ * A @serial of 0 means the transfer was never submitted.
+ */
+typedef struct
+{
+  VkDeviceSize offset;
+  VkDeviceSize end;
+  GulkanQueue *queue;
+  uint64_t serial;
+} GulkanStagingRegion;
+
+/*
+ * Persistently mapped host visible buffer that uploads are copied into.
+ * Regions are handed out in order and reclaimed from the oldest, the free
+ * space is from @head up to the oldest region that is still in use.
+ */
+typedef struct
+{
+  GMutex mutex;
+  GulkanBuffer *buffer;
+  guchar *data;
+  VkDeviceSize size;
+  VkDeviceSize alignment;
+  VkDeviceSize head;
+  /* GulkanStagingRegion, oldest first */
+  GQueue regions;
+
+  uint64_t bytes_staged;
+  uint64_t wraps;
+  uint64_t fallbacks;
+} GulkanStagingRing;
+
 struct _GulkanDevice
 {
   GObjectClass parent_class;
@@ -23,6 +107,15 @@ struct _GulkanDevice
   GulkanQueue *transfer_queue;
 
   PFN_vkGetMemoryFdKHR extVkGetMemoryFdKHR;
+  PFN_vkGetSemaphoreFdKHR extVkGetSemaphoreFdKHR;
+  PFN_vkImportSemaphoreFdKHR extVkImportSemaphoreFdKHR;
+  PFN_vkGetMemoryFdPropertiesKHR extVkGetMemoryFdPropertiesKHR;
+
+  gboolean has_drm_format_modifier;
+  gboolean has_queue_family_foreign;
+
+  GulkanMemoryAllocator allocator;
+  GulkanStagingRing staging;
 };
 
 G_DEFINE_TYPE (GulkanDevice, gulkan_device, G_TYPE_OBJECT)
@@ -36,6 +129,22 @@ gulkan_device_init (GulkanDevice *self)
   self->transfer_queue = NULL;
   self->graphics_queue = NULL;
   self->extVkGetMemoryFdKHR = 0;
+  self->extVkGetSemaphoreFdKHR = 0;
+  self->extVkImportSemaphoreFdKHR = 0;
+  self->extVkGetMemoryFdPropertiesKHR = 0;
+  self->has_drm_format_modifier = FALSE;
+  self->has_queue_family_foreign = FALSE;
+  memset (&self->allocator, 0, sizeof (self->allocator));
+  g_mutex_init (&self->allocator.mutex);
+  g_mutex_init (&self->staging.mutex);
+  self->staging.buffer = NULL;
+  self->staging.data = NULL;
+  self->staging.size = 0;
+  self->staging.head = 0;
+  g_queue_init (&self->staging.regions);
+  self->staging.bytes_staged = 0;
+  self->staging.wraps = 0;
+  self->staging.fallbacks = 0;
 }
 
 GulkanDevice *
@@ -44,10 +153,36 @@ gulkan_device_new (void)
   return (GulkanDevice*) g_object_new (GULKAN_TYPE_DEVICE, 0);
 }
 
+static void
+_memory_block_free (GulkanDevice      *self,
+                    GulkanMemoryBlock *block);
+
 static void
 gulkan_device_finalize (GObject *gobject)
 {
   GulkanDevice *self = GULKAN_DEVICE (gobject);
+
+  GulkanStagingRegion *region;
+  while ((region = g_queue_pop_head (&self->staging.regions)))
+    g_free (region);
+  if (self->staging.buffer)
+    {
+      gulkan_buffer_unmap (self->staging.buffer);
+      g_object_unref (self->staging.buffer);
+    }
+  g_mutex_clear (&self->staging.mutex);
+
+  for (uint32_t linear = 0; linear < 2; linear++)
+    for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; type++)
+      for (uint32_t class = 0; class < SIZE_CLASS_COUNT; class++)
+        {
+          GSList **slab = &self->allocator.slabs[linear][type][class];
+          for (GSList *l = *slab; l; l = l->next)
+            _memory_block_free (self, l->data);
+          g_clear_pointer (slab, g_slist_free);
+        }
+  g_mutex_clear (&self->allocator.mutex);
+
   if (self->has_transfer_queue)
     {
       if (self->transfer_queue) g_object_unref (self->transfer_queue);
@@ -288,7 +423,19 @@ gulkan_device_create (GulkanDevice    *self,
     {
       g_debug ("Requesting device extensions:");
       for (uint32_t i = 0; i < num_enabled; i++)
-        g_debug ("%s", extension_names[i]);
+        {
+          g_debug ("%s", extension_names[i]);
+#ifdef VK_EXT_image_drm_format_modifier
+          if (strcmp (extension_names[i],
+                      VK_EXT_IMAGE_DRM_FORMAT_MODIFIER_EXTENSION_NAME) == 0)
+            self->has_drm_format_modifier = TRUE;
+#endif
+#ifdef VK_EXT_queue_family_foreign
+          if (strcmp (extension_names[i],
+                      VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME) == 0)
+            self->has_queue_family_foreign = TRUE;
+#endif
+        }
     }
 
   VkPhysicalDeviceFeatures physical_device_features;
@@ -435,6 +582,168 @@ gulkan_device_get_memory_fd (GulkanDevice  *self,
   return TRUE;
 }
 
+/**
+ * gulkan_device_get_memory_fd_properties:
+ * @self: a #GulkanDevice
+ * @fd: a dma-buf fd
+ * @memory_type_bits: Return value for the memory types @fd can be imported as
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+gulkan_device_get_memory_fd_properties (GulkanDevice *self,
+                                        int           fd,
+                                        uint32_t     *memory_type_bits)
+{
+  if (!self->extVkGetMemoryFdPropertiesKHR)
+    self->extVkGetMemoryFdPropertiesKHR =
+      (PFN_vkGetMemoryFdPropertiesKHR)
+        vkGetDeviceProcAddr (self->device, "vkGetMemoryFdPropertiesKHR");
+
+  if (!self->extVkGetMemoryFdPropertiesKHR)
+    {
+      g_printerr ("Gulkan Device: Could not load vkGetMemoryFdPropertiesKHR\n");
+      return FALSE;
+    }
+
+  VkMemoryFdPropertiesKHR props = {
+    .sType = VK_STRUCTURE_TYPE_MEMORY_FD_PROPERTIES_KHR,
+  };
+  VkResult res =
+    self->extVkGetMemoryFdPropertiesKHR (self->device,
+                                         VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT,
+                                         fd, &props);
+  vk_check_error ("vkGetMemoryFdPropertiesKHR", res, FALSE);
+
+  *memory_type_bits = props.memoryTypeBits;
+  return TRUE;
+}
+
+/**
+ * gulkan_device_has_drm_format_modifier:
+ * @self: a #GulkanDevice
+ *
+ * Returns: %TRUE if VK_EXT_image_drm_format_modifier is enabled, which is
+ * required for importing dma-bufs with an explicit layout.
+ */
+gboolean
+gulkan_device_has_drm_format_modifier (GulkanDevice *self)
+{
+  return self->has_drm_format_modifier;
+}
+
+/**
+ * gulkan_device_create_semaphore_export_fd:
+ * @self: a #GulkanDevice
+ * @fd: Return value for the exported fd
+ *
+ * Creates a binary semaphore that can be signaled by another API, e.g. with
+ * GL_EXT_semaphore_fd, after importing @fd. Ownership of @fd is transferred
+ * to the caller, the semaphore has to be freed with
+ * gulkan_device_destroy_semaphore().
+ *
+ * Returns: the semaphore, or VK_NULL_HANDLE on failure.
+ */
+VkSemaphore
+gulkan_device_create_semaphore_export_fd (GulkanDevice *self,
+                                          int          *fd)
+{
+  if (!self->extVkGetSemaphoreFdKHR)
+    self->extVkGetSemaphoreFdKHR =
+      (PFN_vkGetSemaphoreFdKHR)
+        vkGetDeviceProcAddr (self->device, "vkGetSemaphoreFdKHR");
+
+  if (!self->extVkGetSemaphoreFdKHR)
+    {
+      g_printerr ("Gulkan Device: Could not load vkGetSemaphoreFdKHR\n");
+      return VK_NULL_HANDLE;
+    }
+
+  VkExportSemaphoreCreateInfo export_info = {
+    .sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,
+    .handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT
+  };
+
+  VkSemaphoreCreateInfo semaphore_info = {
+    .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    .pNext = &export_info
+  };
+
+  VkSemaphore semaphore;
+  VkResult res = vkCreateSemaphore (self->device, &semaphore_info, NULL,
+                                    &semaphore);
+  vk_check_error ("vkCreateSemaphore", res, VK_NULL_HANDLE);
+
+  VkSemaphoreGetFdInfoKHR fd_info = {
+    .sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
+    .semaphore = semaphore,
+    .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT
+  };
+
+  if (self->extVkGetSemaphoreFdKHR (self->device, &fd_info, fd) != VK_SUCCESS)
+    {
+      g_printerr ("Gulkan Device: Could not get file descriptor for semaphore!\n");
+      vkDestroySemaphore (self->device, semaphore, NULL);
+      return VK_NULL_HANDLE;
+    }
+
+  return semaphore;
+}
+
+/*
+ * Makes the next wait on @semaphore wait for the sync file @fd instead, e.g.
+ * the implicit fence of a dma-buf. Takes ownership of @fd on success.
+ */
+gboolean
+gulkan_device_import_semaphore_sync_fd (GulkanDevice *self,
+                                        VkSemaphore   semaphore,
+                                        int           fd)
+{
+  if (!self->extVkImportSemaphoreFdKHR)
+    self->extVkImportSemaphoreFdKHR =
+      (PFN_vkImportSemaphoreFdKHR)
+        vkGetDeviceProcAddr (self->device, "vkImportSemaphoreFdKHR");
+
+  if (!self->extVkImportSemaphoreFdKHR)
+    {
+      g_printerr ("Gulkan Device: Could not load vkImportSemaphoreFdKHR\n");
+      return FALSE;
+    }
+
+  VkImportSemaphoreFdInfoKHR import_info = {
+    .sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR,
+    .semaphore = semaphore,
+    .flags = VK_SEMAPHORE_IMPORT_TEMPORARY_BIT,
+    .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
+    .fd = fd
+  };
+
+  VkResult res = self->extVkImportSemaphoreFdKHR (self->device, &import_info);
+  vk_check_error ("vkImportSemaphoreFdKHR", res, FALSE);
+  return TRUE;
+}
+
+/*
+ * Returns: the queue family index that transfers ownership of images
+ * imported from other drivers, e.g. dma-bufs.
+ */
+uint32_t
+gulkan_device_get_foreign_queue_family (GulkanDevice *self)
+{
+#ifdef VK_EXT_queue_family_foreign
+  if (self->has_queue_family_foreign)
+    return VK_QUEUE_FAMILY_FOREIGN_EXT;
+#endif
+  return VK_QUEUE_FAMILY_EXTERNAL;
+}
+
+void
+gulkan_device_destroy_semaphore (GulkanDevice *self,
+                                 VkSemaphore   semaphore)
+{
+  vkDestroySemaphore (self->device, semaphore, NULL);
+}
+
 void
 gulkan_device_wait_idle (GulkanDevice *self)
 {
@@ -486,6 +795,21 @@ gulkan_device_print_memory_properties (GulkanDevice *self)
   g_print ("\n====================================\n");
 }
 
+static void
+_print_heap_usage (GulkanDevice *self)
+{
+  GulkanMemoryAllocator *allocator = &self->allocator;
+  g_mutex_lock (&allocator->mutex);
+  for (uint32_t i = 0; i < self->memory_properties.memoryHeapCount; i++)
+    g_print ("Heap %d: gulkan allocated %.2f MB in %u allocations, "
+             "%.2f MB used\n",
+             i,
+             allocator->heap_allocated[i] / 1024.0 / 1024.0,
+             allocator->heap_allocation_count[i],
+             allocator->heap_used[i] / 1024.0 / 1024.0);
+  g_mutex_unlock (&allocator->mutex);
+}
+
 void
 gulkan_device_print_memory_budget (GulkanDevice *self)
 {
@@ -510,6 +834,7 @@ gulkan_device_print_memory_budget (GulkanDevice *self)
 #else
   g_print ("VK_EXT_memory_budget not supported in the vulkan SDK gulkan was compiled with!\n");
 #endif
+  _print_heap_usage (self);
 }
 
 VkDeviceSize
@@ -535,8 +860,563 @@ gulkan_device_get_heap_budget (GulkanDevice *self, uint32_t i)
 #endif
 }
 
+/**
+ * gulkan_device_get_heap_usage:
+ * @self: a #GulkanDevice
+ * @i: the heap index
+ * @allocated: (out) (optional): Return value for the device memory gulkan
+ * allocated from heap @i
+ * @used: (out) (optional): Return value for how much of it is used by
+ * buffers and images
+ * @allocation_count: (out) (optional): Return value for the number of device
+ * memory allocations from heap @i, see maxMemoryAllocationCount
+ *
+ * Only covers memory allocated with gulkan_device_allocate_memory(), not
+ * imported or exported memory.
+ */
+void
+gulkan_device_get_heap_usage (GulkanDevice *self,
+                              uint32_t      i,
+                              VkDeviceSize *allocated,
+                              VkDeviceSize *used,
+                              uint32_t     *allocation_count)
+{
+  GulkanMemoryAllocator *allocator = &self->allocator;
+  g_mutex_lock (&allocator->mutex);
+  if (allocated)
+    *allocated = allocator->heap_allocated[i];
+  if (used)
+    *used = allocator->heap_used[i];
+  if (allocation_count)
+    *allocation_count = allocator->heap_allocation_count[i];
+  g_mutex_unlock (&allocator->mutex);
+}
+
 VkPhysicalDeviceProperties *
 gulkan_device_get_physical_device_properties (GulkanDevice *self)
 {
   return &self->physical_props;
 }
+
+static VkDeviceSize
+_align (VkDeviceSize size, VkDeviceSize alignment)
+{
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+/* Called with the allocator mutex held */
+static gboolean
+_allocate_device_memory (GulkanDevice   *self,
+                         VkDeviceSize    size,
+                         uint32_t        type_index,
+                         VkDeviceMemory *memory,
+                         guchar        **data)
+{
+  VkMemoryAllocateInfo alloc_info = {
+    .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+    .allocationSize = size,
+    .memoryTypeIndex = type_index
+  };
+
+  VkResult res = vkAllocateMemory (self->device, &alloc_info, NULL, memory);
+  vk_check_error ("vkAllocateMemory", res, FALSE);
+
+  *data = NULL;
+  VkMemoryType *type = &self->memory_properties.memoryTypes[type_index];
+  if (type->propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+      res = vkMapMemory (self->device, *memory, 0, VK_WHOLE_SIZE, 0,
+                         (void **) data);
+      if (gulkan_has_error (res, "vkMapMemory", __FILE__, __LINE__))
+        {
+          vkFreeMemory (self->device, *memory, NULL);
+          return FALSE;
+        }
+    }
+
+  GulkanMemoryAllocator *allocator = &self->allocator;
+  allocator->heap_allocated[type->heapIndex] += size;
+  allocator->heap_allocation_count[type->heapIndex]++;
+
+  return TRUE;
+}
+
+/* Called with the allocator mutex held */
+static void
+_free_device_memory (GulkanDevice   *self,
+                     VkDeviceMemory  memory,
+                     VkDeviceSize    size,
+                     uint32_t        type_index)
+{
+  /* Freeing also unmaps */
+  vkFreeMemory (self->device, memory, NULL);
+
+  uint32_t heap = self->memory_properties.memoryTypes[type_index].heapIndex;
+  self->allocator.heap_allocated[heap] -= size;
+  self->allocator.heap_allocation_count[heap]--;
+}
+
+static GulkanMemoryBlock *
+_memory_block_new (GulkanDevice *self,
+                   GSList      **slab,
+                   uint32_t      type_index,
+                   VkDeviceSize  slot_size)
+{
+  GulkanMemoryBlock *block = g_new0 (GulkanMemoryBlock, 1);
+  if (!_allocate_device_memory (self, MEMORY_BLOCK_SIZE, type_index,
+                                &block->memory, &block->data))
+    {
+      g_free (block);
+      return NULL;
+    }
+
+  block->type_index = type_index;
+  block->slab = slab;
+  block->slot_size = slot_size;
+  block->slot_count = (uint32_t) (MEMORY_BLOCK_SIZE / slot_size);
+  block->free_slots = g_new (uint32_t, block->slot_count);
+  /* Hand out the lowest slots first */
+  for (uint32_t i = 0; i < block->slot_count; i++)
+    block->free_slots[i] = block->slot_count - 1 - i;
+  block->free_count = block->slot_count;
+
+  return block;
+}
+
+static void
+_memory_block_free (GulkanDevice      *self,
+                    GulkanMemoryBlock *block)
+{
+  _free_device_memory (self, block->memory, MEMORY_BLOCK_SIZE,
+                       block->type_index);
+  g_free (block->free_slots);
+  g_free (block);
+}
+
+/**
+ * gulkan_device_allocate_memory:
+ * @self: a #GulkanDevice
+ * @requirements: requirements of the buffer or image
+ * @properties: properties the memory needs to have
+ * @linear: whether the memory is for a buffer or a linear image
+ * @memory: (out): Return value for the allocation
+ *
+ * Allocates device memory for a buffer or image, which has to be bound at
+ * @memory->offset. Small allocations share blocks of device memory, so they
+ * don't count towards maxMemoryAllocationCount individually. Host visible
+ * memory is persistently mapped to @memory->data.
+ *
+ * Imported and exported memory can't be sub-allocated, and has to be
+ * allocated with vkAllocateMemory instead.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gulkan_device_allocate_memory (GulkanDevice               *self,
+                               const VkMemoryRequirements *requirements,
+                               VkMemoryPropertyFlags       properties,
+                               gboolean                    linear,
+                               GulkanMemory               *memory)
+{
+  uint32_t type_index;
+  if (!gulkan_device_memory_type_from_properties (self,
+                                                  requirements->memoryTypeBits,
+                                                  properties, &type_index))
+    {
+      g_printerr ("Failed to find matching memoryTypeIndex\n");
+      return FALSE;
+    }
+
+  /* Host visible memory may be flushed, which works in whole atoms */
+  VkDeviceSize atom_size = self->physical_props.limits.nonCoherentAtomSize;
+  VkDeviceSize alignment = MAX (requirements->alignment, atom_size);
+  VkDeviceSize size = _align (MAX (requirements->size, 1), alignment);
+
+  uint32_t shift = MIN_SIZE_CLASS_SHIFT;
+  while (shift <= MAX_SIZE_CLASS_SHIFT && ((VkDeviceSize) 1 << shift) < size)
+    shift++;
+
+  GulkanMemoryAllocator *allocator = &self->allocator;
+  uint32_t heap = self->memory_properties.memoryTypes[type_index].heapIndex;
+
+  g_mutex_lock (&allocator->mutex);
+
+  if (shift > MAX_SIZE_CLASS_SHIFT)
+    {
+      guchar *data;
+      if (!_allocate_device_memory (self, size, type_index,
+                                    &memory->memory, &data))
+        {
+          g_mutex_unlock (&allocator->mutex);
+          return FALSE;
+        }
+      allocator->heap_used[heap] += size;
+      g_mutex_unlock (&allocator->mutex);
+
+      memory->offset = 0;
+      memory->size = size;
+      memory->data = data;
+      memory->type_index = type_index;
+      memory->block = NULL;
+      return TRUE;
+    }
+
+  GSList **slab =
+    &allocator->slabs[linear ? 1 : 0][type_index][shift - MIN_SIZE_CLASS_SHIFT];
+  GulkanMemoryBlock *block = NULL;
+  for (GSList *l = *slab; l; l = l->next)
+    if (((GulkanMemoryBlock *) l->data)->free_count > 0)
+      {
+        block = l->data;
+        break;
+      }
+
+  if (block == NULL)
+    {
+      block = _memory_block_new (self, slab, type_index,
+                                 (VkDeviceSize) 1 << shift);
+      if (block == NULL)
+        {
+          g_mutex_unlock (&allocator->mutex);
+          return FALSE;
+        }
+      *slab = g_slist_prepend (*slab, block);
+    }
+
+  uint32_t slot = block->free_slots[--block->free_count];
+  allocator->heap_used[heap] += block->slot_size;
+  g_mutex_unlock (&allocator->mutex);
+
+  memory->memory = block->memory;
+  memory->offset = slot * block->slot_size;
+  memory->size = block->slot_size;
+  memory->data = block->data ? block->data + memory->offset : NULL;
+  memory->type_index = type_index;
+  memory->block = block;
+
+  return TRUE;
+}
+
+/**
+ * gulkan_device_free_memory:
+ * @self: a #GulkanDevice
+ * @memory: an allocation from gulkan_device_allocate_memory()
+ *
+ * Frees @memory, after the buffer or image bound to it is destroyed.
+ */
+void
+gulkan_device_free_memory (GulkanDevice *self,
+                           GulkanMemory *memory)
+{
+  if (memory->memory == VK_NULL_HANDLE)
+    return;
+
+  GulkanMemoryAllocator *allocator = &self->allocator;
+  uint32_t heap =
+    self->memory_properties.memoryTypes[memory->type_index].heapIndex;
+
+  g_mutex_lock (&allocator->mutex);
+  allocator->heap_used[heap] -= memory->size;
+
+  GulkanMemoryBlock *block = memory->block;
+  if (block == NULL)
+    {
+      _free_device_memory (self, memory->memory, memory->size,
+                           memory->type_index);
+    }
+  else
+    {
+      block->free_slots[block->free_count++] =
+        (uint32_t) (memory->offset / block->slot_size);
+
+      /* Give empty blocks back, but keep the last one of each slab around
+       * so allocating and freeing one resource doesn't thrash. */
+      GSList **slab = block->slab;
+      if (block->free_count == block->slot_count && (*slab)->next != NULL)
+        {
+          *slab = g_slist_remove (*slab, block);
+          _memory_block_free (self, block);
+        }
+    }
+  g_mutex_unlock (&allocator->mutex);
+
+  memset (memory, 0, sizeof (*memory));
+}
+
+static gboolean
+_staging_ring_init (GulkanDevice *self)
+{
+  GulkanStagingRing *ring = &self->staging;
+  if (ring->buffer)
+    return TRUE;
+
+  ring->buffer = gulkan_buffer_new (self, STAGING_RING_SIZE,
+                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+  if (!ring->buffer)
+    return FALSE;
+
+  if (!gulkan_buffer_map (ring->buffer, (void **) &ring->data))
+    {
+      g_clear_object (&ring->buffer);
+      return FALSE;
+    }
+
+  /* Offsets have to be valid for buffer to image copies of any format, and
+   * for flushing non-coherent memory. */
+  VkPhysicalDeviceLimits *limits = &self->physical_props.limits;
+  ring->alignment = MAX (MAX (limits->nonCoherentAtomSize,
+                              limits->optimalBufferCopyOffsetAlignment), 16);
+  ring->size = STAGING_RING_SIZE / ring->alignment * ring->alignment;
+  ring->head = 0;
+
+  return TRUE;
+}
+
+static gboolean
+_staging_region_is_done (GulkanStagingRegion *region)
+{
+  if (region->queue == NULL)
+    return FALSE;
+
+  return region->serial == 0 ||
+         gulkan_queue_is_complete (region->queue, region->serial);
+}
+
+/* Frees regions from the oldest one up to the first that is still in use */
+static void
+_staging_ring_reclaim (GulkanStagingRing *ring)
+{
+  GulkanStagingRegion *region;
+  while ((region = g_queue_peek_head (&ring->regions)) &&
+         _staging_region_is_done (region))
+    g_free (g_queue_pop_head (&ring->regions));
+
+  if (g_queue_is_empty (&ring->regions))
+    ring->head = 0;
+}
+
+static gboolean
+_staging_ring_find (GulkanStagingRing *ring,
+                    VkDeviceSize       size,
+                    VkDeviceSize      *offset)
+{
+  GulkanStagingRegion *oldest = g_queue_peek_head (&ring->regions);
+  VkDeviceSize tail = oldest ? oldest->offset : 0;
+
+  if (oldest == NULL || ring->head > tail)
+    {
+      /* Free space is after the head and before the tail */
+      if (ring->head + size <= ring->size)
+        {
+          *offset = ring->head;
+          return TRUE;
+        }
+      if (size <= tail)
+        {
+          *offset = 0;
+          return TRUE;
+        }
+      return FALSE;
+    }
+
+  /* Wrapped around, free space is between the head and the tail. When they
+   * are equal the ring is full. */
+  if (ring->head < tail && ring->head + size <= tail)
+    {
+      *offset = ring->head;
+      return TRUE;
+    }
+  return FALSE;
+}
+
+/*
+ * Takes @size bytes from the ring, waiting for earlier transfers when it is
+ * full. Called with the ring mutex held, which is dropped while waiting.
+ * Returns NULL when the space can't be freed, because the oldest region is
+ * not submitted yet.
+ */
+static GulkanStagingRegion *
+_staging_ring_alloc (GulkanStagingRing *ring,
+                     VkDeviceSize       size)
+{
+  VkDeviceSize offset;
+
+  _staging_ring_reclaim (ring);
+  while (!_staging_ring_find (ring, size, &offset))
+    {
+      GulkanStagingRegion *oldest = g_queue_peek_head (&ring->regions);
+      if (oldest->queue == NULL)
+        return NULL;
+
+      GulkanQueue *queue = oldest->queue;
+      uint64_t serial = oldest->serial;
+
+      g_mutex_unlock (&ring->mutex);
+      gboolean ret = gulkan_queue_wait (queue, serial);
+      g_mutex_lock (&ring->mutex);
+
+      if (!ret)
+        return NULL;
+
+      _staging_ring_reclaim (ring);
+    }
+
+  if (offset < ring->head)
+    ring->wraps++;
+
+  GulkanStagingRegion *region = g_new0 (GulkanStagingRegion, 1);
+  region->offset = offset;
+  region->end = offset + size;
+  ring->head = region->end;
+  g_queue_push_tail (&ring->regions, region);
+
+  return region;
+}
+
+/*
+ * gulkan_device_stage:
+ * @self: a #GulkanDevice
+ * @data: data to upload
+ * @size: size of @data
+ * @staging: Return value for where @data was copied to
+ *
+ * Copies @data to host visible memory, to be used as the source of a
+ * transfer. Small uploads share a persistently mapped ring buffer, bigger
+ * ones get a dedicated buffer. Every successful call has to be followed by
+ * gulkan_device_unstage() once the transfer is submitted.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gulkan_device_stage (GulkanDevice  *self,
+                     const void    *data,
+                     VkDeviceSize   size,
+                     GulkanStaging *staging)
+{
+  GulkanStagingRing *ring = &self->staging;
+  GulkanStagingRegion *region = NULL;
+
+  if (data == NULL)
+    {
+      g_printerr ("Trying to upload NULL memory.\n");
+      return FALSE;
+    }
+
+  g_mutex_lock (&ring->mutex);
+  if (_staging_ring_init (self))
+    {
+      VkDeviceSize aligned =
+        (size + ring->alignment - 1) / ring->alignment * ring->alignment;
+      if (aligned <= ring->size / 2)
+        region = _staging_ring_alloc (ring, aligned);
+    }
+
+  if (region)
+    ring->bytes_staged += size;
+  else
+    ring->fallbacks++;
+  g_mutex_unlock (&ring->mutex);
+
+  if (region == NULL)
+    {
+      staging->dedicated =
+        gulkan_buffer_new_from_data (self, data, size,
+                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+      if (!staging->dedicated)
+        return FALSE;
+
+      staging->buffer = gulkan_buffer_get_handle (staging->dedicated);
+      staging->offset = 0;
+      staging->region = NULL;
+      return TRUE;
+    }
+
+  staging->buffer = gulkan_buffer_get_handle (ring->buffer);
+  staging->offset = region->offset;
+  staging->region = region;
+  staging->dedicated = NULL;
+
+  /* The region is ours until it is unstaged, no need to hold the mutex */
+  memcpy (ring->data + region->offset, data, size);
+
+  VkMappedMemoryRange memory_range = {
+    .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+    .memory = gulkan_buffer_get_memory_handle (ring->buffer),
+    .offset = gulkan_buffer_get_memory_offset (ring->buffer) + region->offset,
+    .size = region->end - region->offset
+  };
+  VkResult res = vkFlushMappedMemoryRanges (self->device, 1, &memory_range);
+  if (gulkan_has_error (res, "vkFlushMappedMemoryRanges", __FILE__, __LINE__))
+    {
+      gulkan_device_unstage (self, staging, NULL, 0);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * gulkan_device_unstage:
+ * @self: a #GulkanDevice
+ * @staging: staging memory from gulkan_device_stage()
+ * @queue: (nullable): the queue the transfer was submitted to
+ * @serial: the serial of the submission, or 0 if it failed
+ *
+ * Gives staging memory back once the transfer reading from it is done. Ring
+ * space is reclaimed later when the submission completes, dedicated buffers
+ * are freed right away after waiting for it.
+ */
+void
+gulkan_device_unstage (GulkanDevice  *self,
+                       GulkanStaging *staging,
+                       GulkanQueue   *queue,
+                       uint64_t       serial)
+{
+  if (staging->dedicated)
+    {
+      if (queue && serial != 0)
+        gulkan_queue_wait (queue, serial);
+      g_clear_object (&staging->dedicated);
+      return;
+    }
+
+  GulkanStagingRegion *region = staging->region;
+  if (region == NULL)
+    return;
+
+  g_mutex_lock (&self->staging.mutex);
+  /* A NULL queue would keep the region from ever being reclaimed */
+  region->queue = queue ? queue : self->graphics_queue;
+  region->serial = queue ? serial : 0;
+  g_mutex_unlock (&self->staging.mutex);
+
+  staging->region = NULL;
+}
+
+/**
+ * gulkan_device_get_staging_stats:
+ * @self: a #GulkanDevice
+ * @bytes_staged: (out) (optional): Return value for the bytes uploaded
+ * through the staging ring
+ * @wraps: (out) (optional): Return value for how often the ring wrapped
+ * around
+ * @fallbacks: (out) (optional): Return value for the uploads that needed a
+ * dedicated staging buffer
+ */
+void
+gulkan_device_get_staging_stats (GulkanDevice *self,
+                                 uint64_t     *bytes_staged,
+                                 uint64_t     *wraps,
+                                 uint64_t     *fallbacks)
+{
+  g_mutex_lock (&self->staging.mutex);
+  if (bytes_staged)
+    *bytes_staged = self->staging.bytes_staged;
+  if (wraps)
+    *wraps = self->staging.wraps;
+  if (fallbacks)
+    *fallbacks = self->staging.fallbacks;
+  g_mutex_unlock (&self->staging.mutex);
+}
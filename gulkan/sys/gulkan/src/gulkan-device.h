@@ -53,6 +53,22 @@ gulkan_device_get_memory_fd (GulkanDevice  *self,
                              VkDeviceMemory image_memory,
                              int           *fd);
 
+gboolean
+gulkan_device_get_memory_fd_properties (GulkanDevice *self,
+                                        int           fd,
+                                        uint32_t     *memory_type_bits);
+
+gboolean
+gulkan_device_has_drm_format_modifier (GulkanDevice *self);
+
+VkSemaphore
+gulkan_device_create_semaphore_export_fd (GulkanDevice *self,
+                                          int          *fd);
+
+void
+gulkan_device_destroy_semaphore (GulkanDevice *self,
+                                 VkSemaphore   semaphore);
+
 void
 gulkan_device_wait_idle (GulkanDevice *self);
 
@@ -65,6 +81,13 @@ gulkan_device_print_memory_budget (GulkanDevice *self);
 VkDeviceSize
 gulkan_device_get_heap_budget (GulkanDevice *self, uint32_t i);
 
+void
+gulkan_device_get_heap_usage (GulkanDevice *self,
+                              uint32_t      i,
+                              VkDeviceSize *allocated,
+                              VkDeviceSize *used,
+                              uint32_t     *allocation_count);
+
 GulkanQueue*
 gulkan_device_get_graphics_queue (GulkanDevice *self);
 
@@ -74,6 +97,12 @@ gulkan_device_get_transfer_queue (GulkanDevice *self);
 VkPhysicalDeviceProperties *
 gulkan_device_get_physical_device_properties (GulkanDevice *self);
 
+void
+gulkan_device_get_staging_stats (GulkanDevice *self,
+                                 uint64_t     *bytes_staged,
+                                 uint64_t     *wraps,
+                                 uint64_t     *fallbacks);
+
 G_END_DECLS
 
 #endif /* GULKAN_DEVICE_H_ */
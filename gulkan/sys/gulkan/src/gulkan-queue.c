@@ -9,6 +9,60 @@
 #include "gulkan-device.h"
 #include "gulkan-cmd-buffer-private.h"
 
+/* Submissions that can be pending on the GPU at once. Submitting more waits
+ * for the oldest one. */
+#define MAX_IN_FLIGHT 8
+
+/* Unused command buffers each thread keeps around for reuse */
+#define MAX_FREE_CMD_BUFFERS 8
+
+/*
+ * Command pool of one thread. Only the owning thread allocates from or frees
+ * to the pool, other threads only return buffers to @free once their
+ * submission is done. Buffers are reset when they are begun again.
+ *
+ * The ring is found through the thread's thread_rings table. When the
+ * thread exits, the ring is handed to its queue as an orphan and freed once
+ * @last_serial is done. When the queue goes first, it releases the pool and
+ * sets @queue to NULL, the struct is then freed with the thread's table.
+ */
+typedef struct
+{
+  VkDevice device;
+  VkCommandPool pool;
+  /* Held while recording into buffers of this pool */
+  GMutex mutex;
+  GAsyncQueue *free;
+  /* Protected by rings_lock */
+  GulkanQueue *queue;
+  /* Last submission with a buffer of this pool, protected by queue_mutex */
+  uint64_t last_serial;
+} GulkanCmdRing;
+
+static void
+_thread_rings_free (gpointer data);
+
+/* GulkanQueue -> GulkanCmdRing of the calling thread */
+static GPrivate thread_rings = G_PRIVATE_INIT (_thread_rings_free);
+
+/* Protects GulkanCmdRing.queue and the rings of all queues, which both the
+ * queue and exiting threads change. */
+static GMutex rings_lock;
+
+/*
+ * A submission and the resources it keeps alive until its fence signals.
+ * @serial is 0 when the slot is free. The fence is not reset for the next
+ * submission while @waiters threads are blocked on it.
+ */
+typedef struct
+{
+  VkFence fence;
+  uint64_t serial;
+  guint waiters;
+  GulkanCmdBuffer *cmd_buffer;
+  GObject *resources;
+} GulkanSubmission;
+
 struct _GulkanQueue
 {
   GObject parent;
@@ -16,14 +70,26 @@ struct _GulkanQueue
   uint32_t family_index;
 
   VkQueue handle;
-  VkFence fence;
 
   GulkanDevice *device;
 
   VkCommandPool pool;
 
-  GMutex pool_mutex;
+  /* Set of the GulkanCmdRing of each thread, protected by rings_lock */
+  GHashTable *rings;
+  /* Rings of exited threads with submissions in flight, protected by
+   * queue_mutex */
+  GSList *orphans;
+  /* Protects the queue handle and the submission ring */
   GMutex queue_mutex;
+  /* Signaled when a thread stops waiting on a submission fence */
+  GCond waiter_done;
+
+  /* Submission with serial n is in slot n % MAX_IN_FLIGHT */
+  GulkanSubmission submissions[MAX_IN_FLIGHT];
+  uint64_t next_serial;
+  /* All submissions up to this serial are done and retired */
+  uint64_t completed_serial;
 };
 
 G_DEFINE_TYPE (GulkanQueue, gulkan_queue, G_TYPE_OBJECT)
@@ -33,17 +99,18 @@ gulkan_queue_init (GulkanQueue *self)
 {
   self->handle = VK_NULL_HANDLE;
   self->pool = VK_NULL_HANDLE;
-  g_mutex_init (&self->pool_mutex);
+  self->next_serial = 1;
+  self->completed_serial = 0;
+  self->rings = g_hash_table_new (NULL, NULL);
+  self->orphans = NULL;
   g_mutex_init (&self->queue_mutex);
-}
-
-GMutex *
-gulkan_queue_get_pool_mutex (GulkanQueue *self) {
-  return &self->pool_mutex;
+  g_cond_init (&self->waiter_done);
 }
 
 static gboolean
-_init_pool (GulkanQueue *self)
+_create_pool (GulkanQueue              *self,
+              VkCommandPoolCreateFlags  flags,
+              VkCommandPool            *pool)
 {
   VkDevice vk_device = gulkan_device_get_handle (self->device);
 
@@ -51,15 +118,158 @@ _init_pool (GulkanQueue *self)
     {
       .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
       .queueFamilyIndex = self->family_index,
-      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT
+      .flags = flags
     };
 
   VkResult res = vkCreateCommandPool (vk_device, &command_pool_info, NULL,
-                                      &self->pool);
+                                      pool);
   vk_check_error ("vkCreateCommandPool", res, FALSE);
   return TRUE;
 }
 
+static gboolean
+_init_pool (GulkanQueue *self)
+{
+  return _create_pool (self, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                       &self->pool);
+}
+
+/* Frees the buffers and the pool of @ring, the struct is kept */
+static void
+_cmd_ring_release (GulkanCmdRing *ring)
+{
+  /* Unrefs the buffers, which frees them to the pool */
+  g_async_queue_unref (ring->free);
+  ring->free = NULL;
+  vkDestroyCommandPool (ring->device, ring->pool, NULL);
+  ring->pool = VK_NULL_HANDLE;
+}
+
+static void
+_cmd_ring_free (gpointer data)
+{
+  GulkanCmdRing *ring = data;
+  if (ring->pool != VK_NULL_HANDLE)
+    _cmd_ring_release (ring);
+  g_mutex_clear (&ring->mutex);
+  g_free (ring);
+}
+
+/* Rings of exited threads can go once their last submission is done. Must
+ * be called with queue_mutex held. */
+static void
+_collect_orphans (GulkanQueue *self)
+{
+  GSList *l = self->orphans;
+  while (l != NULL)
+    {
+      GSList *next = l->next;
+      GulkanCmdRing *ring = l->data;
+      if (ring->last_serial <= self->completed_serial)
+        {
+          _cmd_ring_free (ring);
+          self->orphans = g_slist_delete_link (self->orphans, l);
+        }
+      l = next;
+    }
+}
+
+/* Called when a thread that used any queue exits */
+static void
+_thread_rings_free (gpointer data)
+{
+  GHashTable *rings = data;
+
+  GHashTableIter iter;
+  gpointer value;
+  g_hash_table_iter_init (&iter, rings);
+  g_mutex_lock (&rings_lock);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      GulkanCmdRing *ring = value;
+      GulkanQueue *queue = ring->queue;
+      if (queue == NULL)
+        {
+          /* The queue is gone and already released the pool */
+          _cmd_ring_free (ring);
+          continue;
+        }
+
+      /* Buffers of the ring can still be in flight, the queue frees it once
+       * they are done. */
+      g_hash_table_remove (queue->rings, ring);
+      ring->queue = NULL;
+      g_mutex_lock (&queue->queue_mutex);
+      queue->orphans = g_slist_prepend (queue->orphans, ring);
+      _collect_orphans (queue);
+      g_mutex_unlock (&queue->queue_mutex);
+    }
+  g_mutex_unlock (&rings_lock);
+
+  g_hash_table_unref (rings);
+}
+
+/* Command pool of the calling thread, created on first use */
+static GulkanCmdRing *
+_get_cmd_ring (GulkanQueue *self)
+{
+  GHashTable *rings = g_private_get (&thread_rings);
+  if (rings == NULL)
+    {
+      rings = g_hash_table_new (NULL, NULL);
+      g_private_set (&thread_rings, rings);
+    }
+
+  GulkanCmdRing *ring = g_hash_table_lookup (rings, self);
+  if (ring != NULL)
+    {
+      g_mutex_lock (&rings_lock);
+      gboolean stale = ring->queue != self;
+      g_mutex_unlock (&rings_lock);
+      if (!stale)
+        return ring;
+
+      /* Left behind by a finalized queue at the same address */
+      g_hash_table_remove (rings, self);
+      _cmd_ring_free (ring);
+    }
+
+  ring = g_new0 (GulkanCmdRing, 1);
+  ring->device = gulkan_device_get_handle (self->device);
+  if (!_create_pool (self,
+                     VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+                     VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                     &ring->pool))
+    {
+      g_free (ring);
+      return NULL;
+    }
+  g_mutex_init (&ring->mutex);
+  ring->free = g_async_queue_new_full (g_object_unref);
+  ring->queue = self;
+  g_hash_table_insert (rings, self, ring);
+
+  g_mutex_lock (&rings_lock);
+  g_hash_table_add (self->rings, ring);
+  g_mutex_unlock (&rings_lock);
+
+  return ring;
+}
+
+/**
+ * gulkan_queue_get_pool_mutex:
+ * @self: a #GulkanQueue
+ *
+ * Returns: the mutex to hold while recording into command buffers the calling
+ * thread got from gulkan_queue_request_cmd_buffer(). Each thread has its own
+ * command pool, so threads don't contend on it.
+ */
+GMutex *
+gulkan_queue_get_pool_mutex (GulkanQueue *self) {
+  GulkanCmdRing *ring = _get_cmd_ring (self);
+  return ring ? &ring->mutex : NULL;
+}
+
 GulkanQueue *
 gulkan_queue_new (GulkanDevice *device, uint32_t family_index)
 {
@@ -70,21 +280,53 @@ gulkan_queue_new (GulkanDevice *device, uint32_t family_index)
   return self;
 }
 
+static void
+_retire (GulkanQueue *self, GulkanSubmission *submission);
+
 static void
 _finalize (GObject *gobject)
 {
   GulkanQueue *self = GULKAN_QUEUE (gobject);
 
-  g_mutex_clear (&self->pool_mutex);
-  g_mutex_clear (&self->queue_mutex);
-
   VkDevice device = gulkan_device_get_handle (self->device);
 
-  vkDestroyFence (device, self->fence, NULL);
+  /* Keeps exiting threads from handing over their rings meanwhile */
+  g_mutex_lock (&rings_lock);
+
+  /* Command buffers have to go back to the pool before it is destroyed */
+  for (uint64_t serial = self->completed_serial + 1;
+       serial < self->next_serial; serial++)
+    {
+      GulkanSubmission *submission =
+        &self->submissions[serial % MAX_IN_FLIGHT];
+      vkWaitForFences (device, 1, &submission->fence, VK_TRUE, UINT64_MAX);
+      _retire (self, submission);
+    }
+
+  for (uint32_t i = 0; i < MAX_IN_FLIGHT; i++)
+    vkDestroyFence (device, self->submissions[i].fence, NULL);
+
+  /* Rings of live threads stay in their thread_rings until they exit */
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init (&iter, self->rings);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      GulkanCmdRing *ring = key;
+      _cmd_ring_release (ring);
+      ring->queue = NULL;
+    }
+  g_hash_table_unref (self->rings);
+  g_slist_free_full (self->orphans, _cmd_ring_free);
+
+  g_mutex_unlock (&rings_lock);
 
   if (self->pool != VK_NULL_HANDLE)
     vkDestroyCommandPool (device, self->pool, NULL);
 
+  g_mutex_clear (&self->queue_mutex);
+  g_cond_clear (&self->waiter_done);
+
   G_OBJECT_CLASS (gulkan_queue_parent_class)->finalize (gobject);
 }
 
@@ -141,64 +383,369 @@ gulkan_queue_initialize (GulkanQueue *self)
 
   VkFenceCreateInfo fence_info = {
     .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-    .flags = VK_FENCE_CREATE_SIGNALED_BIT,
   };
 
-  VkResult res = vkCreateFence (device, &fence_info, NULL, &self->fence);
-  vk_check_error ("vkCreateFence", res, FALSE);
+  for (uint32_t i = 0; i < MAX_IN_FLIGHT; i++)
+    {
+      VkResult res = vkCreateFence (device, &fence_info, NULL,
+                                    &self->submissions[i].fence);
+      vk_check_error ("vkCreateFence", res, FALSE);
+    }
 
   return TRUE;
 }
 
+/**
+ * gulkan_queue_request_cmd_buffer:
+ * @self: a #GulkanQueue
+ *
+ * Returns: a command buffer from the calling thread's pool, reused from an
+ * earlier request if one is free. Give it back with
+ * gulkan_queue_free_cmd_buffer() before the thread exits, the pool is
+ * destroyed once the thread's submissions are done.
+ */
 GulkanCmdBuffer *
 gulkan_queue_request_cmd_buffer (GulkanQueue *self)
 {
-  g_mutex_lock (&self->pool_mutex);
-  GulkanCmdBuffer *cmd_buffer = gulkan_cmd_buffer_new (self->device, self);
-  g_mutex_unlock (&self->pool_mutex);
+  GulkanCmdRing *ring = _get_cmd_ring (self);
+  if (ring == NULL)
+    return NULL;
+
+  g_mutex_lock (&ring->mutex);
+  /* Only this thread touches the pool, so excess buffers are freed here */
+  while (g_async_queue_length (ring->free) > MAX_FREE_CMD_BUFFERS)
+    g_object_unref (g_async_queue_try_pop (ring->free));
+
+  GulkanCmdBuffer *cmd_buffer = g_async_queue_try_pop (ring->free);
+  if (cmd_buffer == NULL)
+    cmd_buffer = gulkan_cmd_buffer_new (self->device, self, ring->pool, ring);
+  g_mutex_unlock (&ring->mutex);
+
+  if (cmd_buffer != NULL)
+    gulkan_cmd_buffer_hold (cmd_buffer);
+
   return cmd_buffer;
 }
 
+/**
+ * gulkan_queue_free_cmd_buffer:
+ * @self: a #GulkanQueue
+ * @cmd_buffer: a #GulkanCmdBuffer from gulkan_queue_request_cmd_buffer()
+ *
+ * Gives @cmd_buffer back for reuse. If it is part of a submission still in
+ * flight, it is reused once the submission is done. Can be called from any
+ * thread.
+ */
 void
 gulkan_queue_free_cmd_buffer (GulkanQueue *self,
                               GulkanCmdBuffer *cmd_buffer)
 {
-  g_mutex_lock (&self->pool_mutex);
-  g_object_unref (cmd_buffer);
-  g_mutex_unlock (&self->pool_mutex);
+  (void) self;
+  if (gulkan_cmd_buffer_release (cmd_buffer))
+    {
+      GulkanCmdRing *ring = gulkan_cmd_buffer_get_ring (cmd_buffer);
+      g_async_queue_push (ring->free, cmd_buffer);
+    }
 }
 
-gboolean
-gulkan_queue_submit (GulkanQueue *self, GulkanCmdBuffer *cmd_buffer)
+/* Must be called with queue_mutex held */
+static void
+_retire (GulkanQueue *self, GulkanSubmission *submission)
+{
+  if (submission->cmd_buffer)
+    gulkan_queue_free_cmd_buffer (self, submission->cmd_buffer);
+  submission->cmd_buffer = NULL;
+  g_clear_object (&submission->resources);
+  self->completed_serial = MAX (self->completed_serial, submission->serial);
+  submission->serial = 0;
+}
+
+/*
+ * Retires the submissions that are done, oldest first. Submissions on a
+ * queue finish in order, so this stops at the first one that is still
+ * pending. Must be called with queue_mutex held.
+ */
+static void
+_collect (GulkanQueue *self)
+{
+  VkDevice device = gulkan_device_get_handle (self->device);
+  for (uint64_t serial = self->completed_serial + 1;
+       serial < self->next_serial; serial++)
+    {
+      GulkanSubmission *submission =
+        &self->submissions[serial % MAX_IN_FLIGHT];
+      if (vkGetFenceStatus (device, submission->fence) != VK_SUCCESS)
+        break;
+      _retire (self, submission);
+    }
+
+  if (self->orphans != NULL)
+    _collect_orphans (self);
+}
+
+static uint64_t
+_submit (GulkanQueue        *self,
+         const VkSubmitInfo *submit_info,
+         GulkanCmdBuffer    *cmd_buffer,
+         gpointer            resources);
+
+/**
+ * gulkan_queue_submit_async:
+ * @self: a #GulkanQueue
+ * @cmd_buffer: a recorded #GulkanCmdBuffer from @self
+ * @resources: (transfer full) (nullable): an object to unref once the GPU is
+ * done with the submission, e.g. a staging buffer
+ *
+ * Ends and submits @cmd_buffer without waiting for it to execute. The queue
+ * holds on to @cmd_buffer until it is done, so the caller can give it back
+ * with gulkan_queue_free_cmd_buffer() right away.
+ *
+ * A limited number of submissions can be in flight. When all are used, this
+ * waits for the oldest one.
+ *
+ * Returns: a serial to pass to gulkan_queue_wait() or
+ * gulkan_queue_is_complete(), or 0 if the submission failed.
+ */
+uint64_t
+gulkan_queue_submit_async (GulkanQueue     *self,
+                           GulkanCmdBuffer *cmd_buffer,
+                           gpointer         resources)
+{
+  return gulkan_queue_submit_wait_async (self, cmd_buffer, NULL, 0, 0,
+                                         resources);
+}
+
+/**
+ * gulkan_queue_submit_wait_async:
+ * @self: a #GulkanQueue
+ * @cmd_buffer: a recorded #GulkanCmdBuffer from @self
+ * @wait_semaphores: (array length=n_wait_semaphores) (nullable): binary
+ * semaphores with pending signal operations
+ * @n_wait_semaphores: number of @wait_semaphores
+ * @stage_mask: pipeline stages of @cmd_buffer that wait for the semaphores
+ * @resources: (transfer full) (nullable): an object to unref once the GPU is
+ * done with the submission
+ *
+ * Like gulkan_queue_submit_async(), but @cmd_buffer also waits for
+ * @wait_semaphores, in the same submission. The semaphores are unsignaled
+ * again once the returned serial completes.
+ *
+ * Returns: a serial, or 0 if the submission failed.
+ */
+uint64_t
+gulkan_queue_submit_wait_async (GulkanQueue         *self,
+                                GulkanCmdBuffer     *cmd_buffer,
+                                const VkSemaphore   *wait_semaphores,
+                                uint32_t             n_wait_semaphores,
+                                VkPipelineStageFlags stage_mask,
+                                gpointer             resources)
 {
   VkCommandBuffer cmd_buffer_handle = gulkan_cmd_buffer_get_handle (cmd_buffer);
   if (self->handle == VK_NULL_HANDLE)
     {
       g_printerr ("Trying to submit empty command buffer\n.");
-      return FALSE;
+      if (resources)
+        g_object_unref (resources);
+      return 0;
     }
 
   VkResult res = vkEndCommandBuffer (cmd_buffer_handle);
-  vk_check_error ("vkEndCommandBuffer", res, FALSE);
+  if (gulkan_has_error (res, "vkEndCommandBuffer", __FILE__, __LINE__))
+    {
+      if (resources)
+        g_object_unref (resources);
+      return 0;
+    }
 
-  g_mutex_lock (&self->queue_mutex);
-  VkDevice d = gulkan_device_get_handle (self->device);
-  res = vkWaitForFences (d, 1, &self->fence, VK_TRUE, UINT64_MAX);
-  res = vkResetFences (d, 1, &self->fence);
+  VkPipelineStageFlags *stage_masks = g_new (VkPipelineStageFlags,
+                                             n_wait_semaphores);
+  for (uint32_t i = 0; i < n_wait_semaphores; i++)
+    stage_masks[i] = stage_mask;
 
   VkSubmitInfo submit_info = {
     .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    .waitSemaphoreCount = n_wait_semaphores,
+    .pWaitSemaphores = wait_semaphores,
+    .pWaitDstStageMask = stage_masks,
     .commandBufferCount = 1,
     .pCommandBuffers = &cmd_buffer_handle
   };
 
-  res = vkQueueSubmit (self->handle, 1, &submit_info, self->fence);
+  uint64_t serial = _submit (self, &submit_info, cmd_buffer, resources);
+  g_free (stage_masks);
+  return serial;
+}
+
+/*
+ * Submits @submit_info with the fence of the next slot in the ring. The slot
+ * holds on to @cmd_buffer, if any, and @resources until the fence signals.
+ */
+static uint64_t
+_submit (GulkanQueue        *self,
+         const VkSubmitInfo *submit_info,
+         GulkanCmdBuffer    *cmd_buffer,
+         gpointer            resources)
+{
+  g_mutex_lock (&self->queue_mutex);
+  VkDevice device = gulkan_device_get_handle (self->device);
+
+  uint64_t serial;
+  GulkanSubmission *submission;
+  for (;;)
+    {
+      serial = self->next_serial;
+      submission = &self->submissions[serial % MAX_IN_FLIGHT];
+      if (submission->serial != 0)
+        {
+          /* Ring is full, wait for the oldest submission */
+          vkWaitForFences (device, 1, &submission->fence, VK_TRUE, UINT64_MAX);
+          _collect (self);
+        }
+
+      /* Threads in gulkan_queue_wait() can still be blocked on the fence of
+       * the retired submission. Resetting it under them would leave them
+       * waiting forever if the next submission fails. */
+      if (submission->waiters == 0)
+        break;
+      g_cond_wait (&self->waiter_done, &self->queue_mutex);
+    }
+
+  vkResetFences (device, 1, &submission->fence);
+
+  VkResult res = vkQueueSubmit (self->handle, 1, submit_info,
+                                submission->fence);
+  if (gulkan_has_error (res, "vkQueueSubmit", __FILE__, __LINE__))
+    {
+      g_mutex_unlock (&self->queue_mutex);
+      if (resources)
+        g_object_unref (resources);
+      return 0;
+    }
+
+  submission->serial = serial;
+  if (cmd_buffer)
+    {
+      gulkan_cmd_buffer_hold (cmd_buffer);
+      GulkanCmdRing *ring = gulkan_cmd_buffer_get_ring (cmd_buffer);
+      ring->last_serial = serial;
+    }
+  submission->cmd_buffer = cmd_buffer;
+  submission->resources = resources;
+  self->next_serial++;
 
-  vkQueueWaitIdle (self->handle);
+  _collect (self);
+  g_mutex_unlock (&self->queue_mutex);
 
+  return serial;
+}
+
+/**
+ * gulkan_queue_is_complete:
+ * @self: a #GulkanQueue
+ * @serial: a serial returned by gulkan_queue_submit_async()
+ *
+ * Returns: whether the GPU is done with the submission, without blocking.
+ */
+gboolean
+gulkan_queue_is_complete (GulkanQueue *self, uint64_t serial)
+{
+  g_mutex_lock (&self->queue_mutex);
+  _collect (self);
+  gboolean complete = serial <= self->completed_serial;
   g_mutex_unlock (&self->queue_mutex);
-  vk_check_error ("vkQueueSubmit", res, FALSE);
+  return complete;
+}
 
+/**
+ * gulkan_queue_wait:
+ * @self: a #GulkanQueue
+ * @serial: a serial returned by gulkan_queue_submit_async()
+ *
+ * Blocks until the GPU is done with the submission and everything submitted
+ * to @self before it. Other threads can keep submitting in the meantime.
+ *
+ * Returns: %TRUE on success, %FALSE if @serial was never submitted.
+ */
+gboolean
+gulkan_queue_wait (GulkanQueue *self, uint64_t serial)
+{
+  g_mutex_lock (&self->queue_mutex);
+  _collect (self);
+  if (serial <= self->completed_serial)
+    {
+      g_mutex_unlock (&self->queue_mutex);
+      return TRUE;
+    }
+  if (serial >= self->next_serial)
+    {
+      g_mutex_unlock (&self->queue_mutex);
+      g_warning ("Waiting for submission %" G_GUINT64_FORMAT
+                 " that was never made.\n", serial);
+      return FALSE;
+    }
 
+  /* The slot can't be reused while we wait without holding the mutex, see
+   * gulkan_queue_submit_async(). */
+  GulkanSubmission *submission = &self->submissions[serial % MAX_IN_FLIGHT];
+  VkFence fence = submission->fence;
+  submission->waiters++;
+  g_mutex_unlock (&self->queue_mutex);
+
+  VkDevice device = gulkan_device_get_handle (self->device);
+  VkResult res = vkWaitForFences (device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+  g_mutex_lock (&self->queue_mutex);
+  submission->waiters--;
+  _collect (self);
+  g_cond_broadcast (&self->waiter_done);
+  g_mutex_unlock (&self->queue_mutex);
+
+  vk_check_error ("vkWaitForFences", res, FALSE);
   return TRUE;
 }
+
+/**
+ * gulkan_queue_submit:
+ * @self: a #GulkanQueue
+ * @cmd_buffer: a recorded #GulkanCmdBuffer from @self
+ *
+ * Like gulkan_queue_submit_async(), but waits until the GPU is done.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gulkan_queue_submit (GulkanQueue *self, GulkanCmdBuffer *cmd_buffer)
+{
+  uint64_t serial = gulkan_queue_submit_async (self, cmd_buffer, NULL);
+  if (serial == 0)
+    return FALSE;
+
+  return gulkan_queue_wait (self, serial);
+}
+
+/**
+ * gulkan_queue_wait_semaphore:
+ * @self: a #GulkanQueue
+ * @semaphore: a binary semaphore with a pending signal operation
+ * @stage_mask: pipeline stages that have to wait for @semaphore
+ *
+ * Makes all work submitted to the queue after this call wait for @semaphore,
+ * without blocking the CPU. The semaphore is unsignaled again afterwards.
+ *
+ * Returns: a serial that completes once the wait is done, after which
+ * @semaphore can be destroyed, or 0 on failure.
+ */
+uint64_t
+gulkan_queue_wait_semaphore (GulkanQueue         *self,
+                             VkSemaphore          semaphore,
+                             VkPipelineStageFlags stage_mask)
+{
+  VkSubmitInfo submit_info = {
+    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+    .waitSemaphoreCount = 1,
+    .pWaitSemaphores = &semaphore,
+    .pWaitDstStageMask = &stage_mask,
+  };
+
+  return _submit (self, &submit_info, NULL, NULL);
+}
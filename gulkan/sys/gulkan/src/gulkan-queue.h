@@ -53,6 +53,30 @@ gulkan_queue_free_cmd_buffer (GulkanQueue *self,
 gboolean
 gulkan_queue_submit (GulkanQueue *self, GulkanCmdBuffer *cmd_buffer);
 
+uint64_t
+gulkan_queue_submit_async (GulkanQueue     *self,
+                           GulkanCmdBuffer *cmd_buffer,
+                           gpointer         resources);
+
+uint64_t
+gulkan_queue_submit_wait_async (GulkanQueue         *self,
+                                GulkanCmdBuffer     *cmd_buffer,
+                                const VkSemaphore   *wait_semaphores,
+                                uint32_t             n_wait_semaphores,
+                                VkPipelineStageFlags stage_mask,
+                                gpointer             resources);
+
+gboolean
+gulkan_queue_is_complete (GulkanQueue *self, uint64_t serial);
+
+gboolean
+gulkan_queue_wait (GulkanQueue *self, uint64_t serial);
+
+uint64_t
+gulkan_queue_wait_semaphore (GulkanQueue         *self,
+                             VkSemaphore          semaphore,
+                             VkPipelineStageFlags stage_mask);
+
 GMutex *
 gulkan_queue_get_pool_mutex (GulkanQueue *self);
 
@@ -8,9 +8,17 @@
 
 #include "gulkan-texture.h"
 
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/dma-buf.h>
+#endif
 #include <vulkan/vulkan.h>
 #include "gulkan-buffer.h"
 #include "gulkan-cmd-buffer.h"
+#include "gulkan-device-private.h"
 
 struct _GulkanTexture
 {
@@ -19,7 +27,10 @@ struct _GulkanTexture
   GulkanClient *client;
 
   VkImage image;
+  /* Imported or exported memory */
   VkDeviceMemory image_memory;
+  /* Memory from the device's allocator otherwise */
+  GulkanMemory memory;
   VkImageView image_view;
 
   guint mip_levels;
@@ -27,6 +38,13 @@ struct _GulkanTexture
   VkExtent2D extent;
 
   VkFormat format;
+
+  /* Imported dma-buf, see gulkan_texture_acquire_foreign() */
+  int dmabuf_fd;
+  VkSemaphore foreign_semaphore;
+  uint64_t foreign_serial;
+  /* Layout the image was acquired into, UNDEFINED while it never was */
+  VkImageLayout foreign_layout;
 };
 
 G_DEFINE_TYPE (GulkanTexture, gulkan_texture, G_TYPE_OBJECT)
@@ -41,14 +59,38 @@ typedef struct {
 static GulkanMipMap
 _generate_mipmaps (GdkPixbuf *pixbuf);
 
+static VkAccessFlags
+_get_access_flags (VkImageLayout layout);
+
+static void
+_record_barrier (GulkanTexture   *self,
+                 VkCommandBuffer  cmd_buffer,
+                 GMutex          *mutex,
+                 uint32_t         base_level,
+                 uint32_t         level_count,
+                 VkImageLayout    src_layout,
+                 VkImageLayout    dst_layout);
+
+static void
+_record_generate_mipmaps (GulkanTexture   *self,
+                          VkCommandBuffer  cmd_buffer,
+                          GMutex          *mutex,
+                          VkImageLayout    src_layout,
+                          VkImageLayout    dst_layout);
+
 static void
 gulkan_texture_init (GulkanTexture *self)
 {
   self->image = VK_NULL_HANDLE;
   self->image_memory = VK_NULL_HANDLE;
+  memset (&self->memory, 0, sizeof (self->memory));
   self->image_view = VK_NULL_HANDLE;
   self->format = VK_FORMAT_UNDEFINED;
   self->mip_levels = 1;
+  self->dmabuf_fd = -1;
+  self->foreign_semaphore = VK_NULL_HANDLE;
+  self->foreign_serial = 0;
+  self->foreign_layout = VK_IMAGE_LAYOUT_UNDEFINED;
 }
 
 static void
@@ -57,9 +99,21 @@ _finalize (GObject *gobject)
   GulkanTexture *self = GULKAN_TEXTURE (gobject);
   VkDevice device = gulkan_client_get_device_handle (self->client);
 
+  if (self->foreign_serial != 0)
+    {
+      GulkanDevice *gulkan_device = gulkan_client_get_device (self->client);
+      gulkan_queue_wait (gulkan_device_get_graphics_queue (gulkan_device),
+                         self->foreign_serial);
+    }
+  vkDestroySemaphore (device, self->foreign_semaphore, NULL);
+  if (self->dmabuf_fd >= 0)
+    close (self->dmabuf_fd);
+
   vkDestroyImageView (device, self->image_view, NULL);
   vkDestroyImage (device, self->image, NULL);
   vkFreeMemory (device, self->image_memory, NULL);
+  gulkan_device_free_memory (gulkan_client_get_device (self->client),
+                             &self->memory);
 
   g_object_unref (self->client);
 
@@ -73,15 +127,30 @@ gulkan_texture_class_init (GulkanTextureClass *klass)
   object_class->finalize = _finalize;
 }
 
+/*
+ * Copies @regions of @pixels into the texture. With @generate_mipmaps, only
+ * the first mip level is copied and the others are blitted from it, which
+ * needs a @queue with graphics support. The texture is transitioned from
+ * @src_layout, contents outside of @regions are only kept if it is not
+ * VK_IMAGE_LAYOUT_UNDEFINED.
+ */
 static gboolean
 _upload_pixels (GulkanTexture           *self,
+                GulkanQueue             *queue,
                 guchar                  *pixels,
                 gsize                    size,
                 const VkBufferImageCopy *regions,
-                VkImageLayout            layout)
+                uint32_t                 region_count,
+                gboolean                 generate_mipmaps,
+                VkImageLayout            src_layout,
+                VkImageLayout            dst_layout)
 {
   GulkanDevice *device = gulkan_client_get_device (self->client);
-  GulkanQueue *queue = gulkan_device_get_transfer_queue (device);
+
+  GulkanStaging staging;
+  if (!gulkan_device_stage (device, pixels, size, &staging))
+    return FALSE;
+
   GulkanCmdBuffer *cmd_buffer = gulkan_queue_request_cmd_buffer (queue);
   GMutex *mutex = gulkan_queue_get_pool_mutex (queue);
 
@@ -90,47 +159,132 @@ _upload_pixels (GulkanTexture           *self,
   g_mutex_unlock (mutex);
 
   if (!ret)
-    return FALSE;
-
-  GulkanBuffer *staging_buffer =
-    gulkan_buffer_new (device, size,
-                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    {
+      gulkan_queue_free_cmd_buffer (queue, cmd_buffer);
+      gulkan_device_unstage (device, &staging, queue, 0);
+      return FALSE;
+    }
 
-  if (!staging_buffer)
-    return FALSE;
+  /* Regions are relative to @pixels, which start at the staging offset */
+  VkBufferImageCopy *staged_regions = g_new (VkBufferImageCopy, region_count);
+  for (uint32_t i = 0; i < region_count; i++)
+    {
+      staged_regions[i] = regions[i];
+      staged_regions[i].bufferOffset += staging.offset;
+    }
 
-  if (!gulkan_buffer_upload (staging_buffer, pixels, size))
-    return FALSE;
+  VkCommandBuffer cmd_buffer_handle = gulkan_cmd_buffer_get_handle (cmd_buffer);
 
-  gulkan_texture_record_transfer (self,
-                                  gulkan_cmd_buffer_get_handle (cmd_buffer),
-                                  VK_IMAGE_LAYOUT_UNDEFINED,
-                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+  _record_barrier (self, cmd_buffer_handle, mutex, 0, self->mip_levels,
+                   src_layout,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
   g_mutex_lock (mutex);
-  vkCmdCopyBufferToImage (gulkan_cmd_buffer_get_handle (cmd_buffer),
-                          gulkan_buffer_get_handle (staging_buffer),
+  vkCmdCopyBufferToImage (cmd_buffer_handle,
+                          staging.buffer,
                           self->image,
                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                          self->mip_levels,
-                          regions);
+                          region_count,
+                          staged_regions);
   g_mutex_unlock (mutex);
 
-  gulkan_texture_record_transfer (self,
-                                  gulkan_cmd_buffer_get_handle (cmd_buffer),
-                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                  layout);
+  g_free (staged_regions);
 
-  if (!gulkan_queue_submit (queue, cmd_buffer))
-    return FALSE;
+  if (generate_mipmaps)
+    _record_generate_mipmaps (self, cmd_buffer_handle, mutex,
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              dst_layout);
+  else
+    _record_barrier (self, cmd_buffer_handle, mutex, 0, self->mip_levels,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, dst_layout);
 
-  g_object_unref (staging_buffer);
+  /* Callers expect the texture to be ready for any queue on return, so this
+   * still waits. The staging space is reclaimed with the submission's fence. */
+  uint64_t serial = gulkan_queue_submit_async (queue, cmd_buffer, NULL);
+  ret = serial != 0 && gulkan_queue_wait (queue, serial);
+
+  gulkan_device_unstage (device, &staging, queue, serial);
   gulkan_queue_free_cmd_buffer (queue, cmd_buffer);
 
-  return TRUE;
+  return ret;
+}
+
+static VkImageTiling
+_get_tiling (VkFormat format)
+{
+  /* TODO: Check with vkGetPhysicalDeviceFormatProperties */
+  switch (format)
+    {
+    case VK_FORMAT_R8G8B8_SRGB:
+    case VK_FORMAT_R8G8B8_UNORM:
+      return VK_IMAGE_TILING_LINEAR;
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_R8G8B8A8_UNORM:
+      return VK_IMAGE_TILING_OPTIMAL;
+    default:
+      g_printerr ("Warning: No tiling for format %s (%d) specified.\n",
+                  vk_format_string(format), format);
+      return VK_IMAGE_TILING_OPTIMAL;
+    }
+}
+
+/*
+ * Whether mip levels of @format can be generated with vkCmdBlitImage. The
+ * format has to be usable as blit source and destination, and support linear
+ * filtering.
+ */
+static gboolean
+_supports_blit_mipmaps (GulkanClient *client,
+                        VkFormat      format)
+{
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties (
+    gulkan_client_get_physical_device_handle (client), format, &props);
+
+  VkFormatFeatureFlags features =
+    _get_tiling (format) == VK_IMAGE_TILING_LINEAR ?
+      props.linearTilingFeatures : props.optimalTilingFeatures;
+  VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  return (features & needed) == needed;
+}
+
+/**
+ * gulkan_texture_get_mip_level_count:
+ * @extent: Extent of the first mip level
+ *
+ * Returns: the number of mip levels down to 1x1 for a texture of @extent, as
+ * used by gulkan_texture_new_from_pixbuf() when mip levels are generated on
+ * the GPU.
+ */
+guint
+gulkan_texture_get_mip_level_count (VkExtent2D extent)
+{
+  guint levels = 1;
+  uint32_t size = MAX (extent.width, extent.height);
+  while (size > 1)
+    {
+      size /= 2;
+      levels++;
+    }
+  return levels;
 }
 
+/**
+ * gulkan_texture_new_from_pixbuf:
+ * @client: a #GulkanClient
+ * @pixbuf: RGBA pixels to upload
+ * @format: VkFormat of the texture
+ * @layout: VkImageLayout the texture is left in
+ * @create_mipmaps: Whether to create a full mip chain
+ *
+ * Mip levels are generated on the GPU with vkCmdBlitImage when @format
+ * supports it, otherwise they are scaled on the CPU and uploaded with the
+ * first level.
+ *
+ * Returns: the initialized #GulkanTexture, or %NULL on failure
+ */
 GulkanTexture *
 gulkan_texture_new_from_pixbuf (GulkanClient   *client,
                                 GdkPixbuf      *pixbuf,
@@ -145,15 +299,51 @@ gulkan_texture_new_from_pixbuf (GulkanClient   *client,
 
   GulkanTexture *self;
 
-  if (create_mipmaps)
+  if (create_mipmaps && _supports_blit_mipmaps (client, format))
+    {
+      self = gulkan_texture_new_mip_levels (
+        client, extent, gulkan_texture_get_mip_level_count (extent), format);
+
+      VkBufferImageCopy buffer_image_copy = {
+        .imageSubresource = {
+          .baseArrayLayer = 0,
+          .layerCount = 1,
+          .mipLevel = 0,
+          .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        },
+        .imageExtent = {
+          .width = extent.width,
+          .height = extent.height,
+          .depth = 1,
+        }
+      };
+
+      GulkanDevice *device = gulkan_client_get_device (client);
+      if (self &&
+          !_upload_pixels (self, gulkan_device_get_graphics_queue (device),
+                           gdk_pixbuf_get_pixels (pixbuf),
+                           gdk_pixbuf_get_byte_length (pixbuf),
+                           &buffer_image_copy, 1, TRUE,
+                           VK_IMAGE_LAYOUT_UNDEFINED, layout))
+        {
+          g_printerr ("ERROR: Could not upload pixels.\n");
+          g_object_unref (self);
+          self = NULL;
+        }
+    }
+  else if (create_mipmaps)
     {
       GulkanMipMap mipmap = _generate_mipmaps (pixbuf);
 
       self = gulkan_texture_new_mip_levels (client, extent,
                                             mipmap.levels, format);
 
-      if(!_upload_pixels (self, mipmap.buffer, mipmap.size,
-                          mipmap.buffer_image_copies, layout))
+      GulkanDevice *device = gulkan_client_get_device (client);
+      if (self &&
+          !_upload_pixels (self, gulkan_device_get_transfer_queue (device),
+                           mipmap.buffer, mipmap.size,
+                           mipmap.buffer_image_copies, mipmap.levels, FALSE,
+                           VK_IMAGE_LAYOUT_UNDEFINED, layout))
         {
           g_printerr ("ERROR: Could not upload pixels.\n");
           g_object_unref (self);
@@ -232,23 +422,7 @@ gulkan_texture_new_mip_levels (GulkanClient *client,
 
   VkDevice vk_device = gulkan_client_get_device_handle (client);
 
-  /* TODO: Check with vkGetPhysicalDeviceFormatProperties */
-  VkImageTiling tiling;
-  switch (format)
-    {
-    case VK_FORMAT_R8G8B8_SRGB:
-    case VK_FORMAT_R8G8B8_UNORM:
-      tiling = VK_IMAGE_TILING_LINEAR;
-      break;
-    case VK_FORMAT_R8G8B8A8_SRGB:
-    case VK_FORMAT_R8G8B8A8_UNORM:
-      tiling = VK_IMAGE_TILING_OPTIMAL;
-      break;
-    default:
-      g_printerr ("Warning: No tiling for format %s (%d) specified.\n",
-                  vk_format_string(format), format);
-      tiling = VK_IMAGE_TILING_OPTIMAL;
-    }
+  VkImageTiling tiling = _get_tiling (format);
 
   VkImageCreateInfo image_info = {
     .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
@@ -274,20 +448,14 @@ gulkan_texture_new_mip_levels (GulkanClient *client,
   vkGetImageMemoryRequirements (vk_device, self->image,
                                 &memory_requirements);
 
-  VkMemoryAllocateInfo memory_info =
-  {
-    .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-    .allocationSize = memory_requirements.size
-  };
-  gulkan_device_memory_type_from_properties (
-    gulkan_client_get_device (client),
-    memory_requirements.memoryTypeBits,
-    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-    &memory_info.memoryTypeIndex);
-  res = vkAllocateMemory (vk_device, &memory_info,
-                          NULL, &self->image_memory);
-  vk_check_error ("vkAllocateMemory", res, NULL);
-  res = vkBindImageMemory (vk_device, self->image, self->image_memory, 0);
+  if (!gulkan_device_allocate_memory (gulkan_client_get_device (client),
+                                      &memory_requirements,
+                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                      tiling == VK_IMAGE_TILING_LINEAR,
+                                      &self->memory))
+    return NULL;
+  res = vkBindImageMemory (vk_device, self->image, self->memory.memory,
+                           self->memory.offset);
   vk_check_error ("vkBindImageMemory", res, NULL);
 
   VkImageViewCreateInfo image_view_info =
@@ -319,21 +487,23 @@ _generate_mipmaps (GdkPixbuf *pixbuf)
 
   GulkanMipMap mipmap = {
     .levels = 1,
-    .size = sizeof (uint8_t) * (guint) width * (guint) height * 4 * 2,
+    .size = gdk_pixbuf_get_byte_length (pixbuf),
   };
 
-  mipmap.buffer = g_malloc (mipmap.size);
-
-  /* Test how many levels we will be generating */
+  /* Test how many levels we will be generating, and how big they are.
+   * The level pixbufs are RGBA, so their rows are never padded. */
   int test_width = width;
   int test_height = height;
   while (test_width > 1 && test_height > 1)
     {
       test_width /= 2;
       test_height /= 2;
+      mipmap.size += (VkDeviceSize) test_width * (VkDeviceSize) test_height * 4;
       mipmap.levels++;
     }
 
+  mipmap.buffer = g_malloc (mipmap.size);
+
   mipmap.buffer_image_copies =
     g_malloc (sizeof(VkBufferImageCopy) * mipmap.levels);
 
@@ -420,6 +590,8 @@ gulkan_texture_upload_pixels (GulkanTexture  *self,
       return FALSE;
     }
 
+  GulkanDevice *device = gulkan_client_get_device (self->client);
+
   VkBufferImageCopy buffer_image_copy = {
     .imageSubresource = {
       .baseArrayLayer = 0,
@@ -434,7 +606,192 @@ gulkan_texture_upload_pixels (GulkanTexture  *self,
     }
   };
 
-  return _upload_pixels (self, pixels, size, &buffer_image_copy, layout);
+  return _upload_pixels (self, gulkan_device_get_transfer_queue (device),
+                         pixels, size, &buffer_image_copy, 1, FALSE,
+                         VK_IMAGE_LAYOUT_UNDEFINED, layout);
+}
+
+/* Bytes per texel of the formats regions can be uploaded to, 0 if not
+ * supported. Buffer offsets of copies have to be multiples of both the texel
+ * size and 4, which any texel offset of these formats is. Image offsets need
+ * no alignment, as regions are copied on the graphics queue. */
+static VkDeviceSize
+_get_texel_size (VkFormat format)
+{
+  switch (format)
+    {
+      case VK_FORMAT_R8G8B8A8_UNORM:
+      case VK_FORMAT_R8G8B8A8_SRGB:
+      case VK_FORMAT_B8G8R8A8_UNORM:
+      case VK_FORMAT_B8G8R8A8_SRGB:
+      case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+      case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        return 4;
+      case VK_FORMAT_R16G16B16A16_UNORM:
+      case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return 8;
+      case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16;
+      default:
+        return 0;
+    }
+}
+
+/* Clips @rect to the @x, @y, @width, @height area. Returns FALSE if nothing
+ * is left. */
+static gboolean
+_clip_rect (VkRect2D *rect,
+            uint32_t  x,
+            uint32_t  y,
+            uint32_t  width,
+            uint32_t  height)
+{
+  int64_t x0 = MAX ((int64_t) rect->offset.x, (int64_t) x);
+  int64_t y0 = MAX ((int64_t) rect->offset.y, (int64_t) y);
+  int64_t x1 = MIN ((int64_t) rect->offset.x + rect->extent.width,
+                    (int64_t) x + width);
+  int64_t y1 = MIN ((int64_t) rect->offset.y + rect->extent.height,
+                    (int64_t) y + height);
+  if (x1 <= x0 || y1 <= y0)
+    return FALSE;
+
+  rect->offset.x = (int32_t) x0;
+  rect->offset.y = (int32_t) y0;
+  rect->extent.width = (uint32_t) (x1 - x0);
+  rect->extent.height = (uint32_t) (y1 - y0);
+  return TRUE;
+}
+
+/**
+ * gulkan_texture_upload_region:
+ * @self: a #GulkanTexture with one mip level
+ * @pixels: the @x, @y, @width, @height area of the texture
+ * @size: size of @pixels in bytes
+ * @x: left edge of the area
+ * @y: top edge of the area
+ * @width: width of the area
+ * @height: height of the area
+ * @row_length: texels from the start of one row of @pixels to the next, or 0
+ * if the rows are tightly packed
+ * @rects: (array length=rect_count) (nullable): parts of the area to upload,
+ * in texture coordinates. %NULL uploads the whole area.
+ * @rect_count: number of @rects
+ * @layout: the layout the texture is in, and is left in
+ *
+ * Uploads parts of the texture, keeping the contents outside of them. Only
+ * the texels that are copied are staged, so @pixels can be a full image of
+ * which only a few small rectangles changed.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+gulkan_texture_upload_region (GulkanTexture  *self,
+                              guchar         *pixels,
+                              gsize           size,
+                              uint32_t        x,
+                              uint32_t        y,
+                              uint32_t        width,
+                              uint32_t        height,
+                              uint32_t        row_length,
+                              const VkRect2D *rects,
+                              uint32_t        rect_count,
+                              VkImageLayout   layout)
+{
+  if (self->mip_levels != 1)
+    {
+      g_warning ("Trying to upload one mip level to multi level texture.\n");
+      return FALSE;
+    }
+
+  VkDeviceSize texel_size = _get_texel_size (self->format);
+  if (texel_size == 0)
+    {
+      g_warning ("Uploading regions of format %d is not supported.\n",
+                 self->format);
+      return FALSE;
+    }
+
+  if (row_length == 0)
+    row_length = width;
+
+  if (width == 0 || height == 0)
+    return TRUE;
+
+  if ((uint64_t) x + width > self->extent.width ||
+      (uint64_t) y + height > self->extent.height ||
+      row_length < width ||
+      ((VkDeviceSize) (height - 1) * row_length + width) * texel_size > size)
+    {
+      g_warning ("Region %ux%u+%u+%u does not fit the texture or the data.\n",
+                 width, height, x, y);
+      return FALSE;
+    }
+
+  VkRect2D area = {
+    .offset = { (int32_t) x, (int32_t) y },
+    .extent = { width, height },
+  };
+  if (rects == NULL)
+    {
+      rects = &area;
+      rect_count = 1;
+    }
+
+  VkBufferImageCopy *regions = g_new0 (VkBufferImageCopy, rect_count);
+  uint32_t region_count = 0;
+  VkDeviceSize start = G_MAXUINT64;
+  VkDeviceSize end = 0;
+
+  for (uint32_t i = 0; i < rect_count; i++)
+    {
+      VkRect2D rect = rects[i];
+      if (!_clip_rect (&rect, x, y, width, height))
+        continue;
+
+      VkDeviceSize first_row = (VkDeviceSize) ((uint32_t) rect.offset.y - y);
+      VkDeviceSize offset =
+        (first_row * row_length + ((uint32_t) rect.offset.x - x)) * texel_size;
+      VkDeviceSize last =
+        offset + ((VkDeviceSize) (rect.extent.height - 1) * row_length +
+                  rect.extent.width) * texel_size;
+      start = MIN (start, offset);
+      end = MAX (end, last);
+
+      regions[region_count++] = (VkBufferImageCopy) {
+        .bufferOffset = offset,
+        .bufferRowLength = row_length,
+        .imageSubresource = {
+          .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+          .mipLevel = 0,
+          .baseArrayLayer = 0,
+          .layerCount = 1,
+        },
+        .imageOffset = { rect.offset.x, rect.offset.y, 0 },
+        .imageExtent = { rect.extent.width, rect.extent.height, 1 },
+      };
+    }
+
+  if (region_count == 0)
+    {
+      g_free (regions);
+      return TRUE;
+    }
+
+  /* Only stage the rows the rectangles span */
+  for (uint32_t i = 0; i < region_count; i++)
+    regions[i].bufferOffset -= start;
+
+  /* Textures are created with exclusive sharing and sampled on the graphics
+   * queue. Without an ownership transfer, another queue family could not
+   * keep the contents outside of the regions. */
+  GulkanDevice *device = gulkan_client_get_device (self->client);
+  gboolean ret =
+    _upload_pixels (self, gulkan_device_get_graphics_queue (device),
+                    pixels + start, end - start, regions, region_count,
+                    FALSE, layout, layout);
+
+  g_free (regions);
+  return ret;
 }
 
 gboolean
@@ -565,6 +922,568 @@ gulkan_texture_new_from_dmabuf (GulkanClient *client,
   return self;
 }
 
+#ifdef VK_EXT_image_drm_format_modifier
+static gboolean
+_is_modifier_supported (GulkanClient *client,
+                        VkFormat      format,
+                        uint64_t      modifier,
+                        uint32_t      n_planes,
+                        VkImageUsageFlags usage)
+{
+  VkPhysicalDevice physical_device =
+    gulkan_client_get_physical_device_handle (client);
+
+  VkDrmFormatModifierPropertiesListEXT modifier_list = {
+    .sType = VK_STRUCTURE_TYPE_DRM_FORMAT_MODIFIER_PROPERTIES_LIST_EXT,
+  };
+  VkFormatProperties2 format_props = {
+    .sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2,
+    .pNext = &modifier_list,
+  };
+  vkGetPhysicalDeviceFormatProperties2 (physical_device, format,
+                                        &format_props);
+
+  VkDrmFormatModifierPropertiesEXT *modifiers =
+    g_malloc (sizeof (VkDrmFormatModifierPropertiesEXT) *
+              modifier_list.drmFormatModifierCount);
+  modifier_list.pDrmFormatModifierProperties = modifiers;
+  vkGetPhysicalDeviceFormatProperties2 (physical_device, format,
+                                        &format_props);
+
+  gboolean found = FALSE;
+  for (uint32_t i = 0; i < modifier_list.drmFormatModifierCount; i++)
+    {
+      if (modifiers[i].drmFormatModifier == modifier)
+        {
+          VkFormatFeatureFlags features =
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+            VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+          found = modifiers[i].drmFormatModifierPlaneCount == n_planes &&
+            (modifiers[i].drmFormatModifierTilingFeatures & features) == features;
+          break;
+        }
+    }
+  g_free (modifiers);
+
+  if (!found)
+    return FALSE;
+
+  VkPhysicalDeviceImageDrmFormatModifierInfoEXT modifier_info = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_DRM_FORMAT_MODIFIER_INFO_EXT,
+    .drmFormatModifier = modifier,
+    .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+  };
+  VkPhysicalDeviceExternalImageFormatInfo external_info = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO,
+    .pNext = &modifier_info,
+    .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT,
+  };
+  VkPhysicalDeviceImageFormatInfo2 image_format_info = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2,
+    .pNext = &external_info,
+    .format = format,
+    .type = VK_IMAGE_TYPE_2D,
+    .tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT,
+    .usage = usage,
+  };
+  VkExternalImageFormatProperties external_props = {
+    .sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES,
+  };
+  VkImageFormatProperties2 image_format_props = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2,
+    .pNext = &external_props,
+  };
+  VkResult res =
+    vkGetPhysicalDeviceImageFormatProperties2 (physical_device,
+                                              &image_format_info,
+                                              &image_format_props);
+  if (res != VK_SUCCESS)
+    return FALSE;
+
+  return (external_props.externalMemoryProperties.externalMemoryFeatures &
+          VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT) != 0;
+}
+#endif
+
+/**
+ * gulkan_texture_new_from_dmabuf_planes:
+ * @client: a #GulkanClient
+ * @n_planes: Number of memory planes
+ * @fds: (array length=n_planes): dma-buf fd of each plane
+ * @offsets: (array length=n_planes): Offset of each plane
+ * @strides: (array length=n_planes): Stride of each plane
+ * @modifier: DRM format modifier of the buffer
+ * @extent: Extent in pixels
+ * @format: VkFormat of the texture
+ * @layout: VkImageLayout to acquire the texture into
+ *
+ * Imports a dma-buf with an explicit memory layout, as e.g. returned by DRI3
+ * BuffersFromPixmap, without copying it. All planes have to be backed by the
+ * same buffer. The fds are not consumed, the caller keeps their ownership.
+ *
+ * The texture is acquired from its producer into @layout, see
+ * gulkan_texture_acquire_foreign().
+ *
+ * Requires VK_EXT_image_drm_format_modifier.
+ *
+ * Returns: the imported #GulkanTexture, or %NULL if the buffer can't be
+ * imported.
+ */
+GulkanTexture *
+gulkan_texture_new_from_dmabuf_planes (GulkanClient   *client,
+                                       uint32_t        n_planes,
+                                       const int      *fds,
+                                       const uint32_t *offsets,
+                                       const uint32_t *strides,
+                                       uint64_t        modifier,
+                                       VkExtent2D      extent,
+                                       VkFormat        format,
+                                       VkImageLayout   layout)
+{
+#ifdef VK_EXT_image_drm_format_modifier
+  GulkanDevice *device = gulkan_client_get_device (client);
+  VkDevice vk_device = gulkan_client_get_device_handle (client);
+
+  if (!gulkan_device_has_drm_format_modifier (device) || n_planes == 0 ||
+      n_planes > 4)
+    return NULL;
+
+  /* Disjoint images are not supported, every plane must be the same buffer */
+  struct stat first_stat;
+  if (fstat (fds[0], &first_stat) != 0)
+    return NULL;
+  for (uint32_t i = 1; i < n_planes; i++)
+    {
+      struct stat plane_stat;
+      if (fstat (fds[i], &plane_stat) != 0 ||
+          plane_stat.st_ino != first_stat.st_ino)
+        return NULL;
+    }
+
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT |
+                            VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  if (!_is_modifier_supported (client, format, modifier, n_planes, usage))
+    return NULL;
+
+  VkSubresourceLayout plane_layouts[4] = { 0 };
+  for (uint32_t i = 0; i < n_planes; i++)
+    {
+      plane_layouts[i].offset = offsets[i];
+      plane_layouts[i].rowPitch = strides[i];
+    }
+
+  VkImageDrmFormatModifierExplicitCreateInfoEXT modifier_info = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_DRM_FORMAT_MODIFIER_EXPLICIT_CREATE_INFO_EXT,
+    .drmFormatModifier = modifier,
+    .drmFormatModifierPlaneCount = n_planes,
+    .pPlaneLayouts = plane_layouts,
+  };
+
+  VkExternalMemoryImageCreateInfo external_memory_image_create_info = {
+    .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+    .pNext = &modifier_info,
+    .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT
+  };
+
+  VkImageCreateInfo image_info = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+    .pNext = &external_memory_image_create_info,
+    .imageType = VK_IMAGE_TYPE_2D,
+    .extent = {
+      .width = extent.width,
+      .height = extent.height,
+      .depth = 1,
+    },
+    .mipLevels = 1,
+    .arrayLayers = 1,
+    .format = format,
+    .tiling = VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT,
+    .samples = VK_SAMPLE_COUNT_1_BIT,
+    .usage = usage,
+    .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    /* DMA buffer only allowed to import as UNDEFINED */
+    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+  };
+
+  GulkanTexture *self = (GulkanTexture*) g_object_new (GULKAN_TYPE_TEXTURE, 0);
+  self->extent = extent;
+  self->client = g_object_ref (client);
+  self->format = format;
+
+  VkResult res;
+  res = vkCreateImage (vk_device, &image_info, NULL, &self->image);
+  if (gulkan_has_error (res, "vkCreateImage", __FILE__, __LINE__))
+    {
+      g_object_unref (self);
+      return NULL;
+    }
+
+  uint32_t fd_memory_type_bits;
+  if (!gulkan_device_get_memory_fd_properties (device, fds[0],
+                                               &fd_memory_type_bits))
+    {
+      g_object_unref (self);
+      return NULL;
+    }
+
+  VkMemoryRequirements memory_requirements;
+  vkGetImageMemoryRequirements (vk_device, self->image,
+                                &memory_requirements);
+
+  VkMemoryDedicatedAllocateInfo dedicated_memory_info = {
+    .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+    .image = self->image,
+    .buffer = VK_NULL_HANDLE
+  };
+
+  /* A successful import takes ownership of the fd */
+  int fd = dup (fds[0]);
+  VkImportMemoryFdInfoKHR import_memory_info = {
+    .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,
+    .pNext = &dedicated_memory_info,
+    .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT,
+    .fd = fd
+  };
+
+  VkMemoryAllocateInfo memory_info = {
+    .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+    .pNext = &import_memory_info,
+    .allocationSize = memory_requirements.size
+  };
+
+  if (fd < 0 ||
+      !gulkan_device_memory_type_from_properties (
+        device, memory_requirements.memoryTypeBits & fd_memory_type_bits,
+        0, &memory_info.memoryTypeIndex))
+    {
+      if (fd >= 0)
+        close (fd);
+      g_object_unref (self);
+      return NULL;
+    }
+
+  res = vkAllocateMemory (vk_device, &memory_info, NULL, &self->image_memory);
+  if (gulkan_has_error (res, "vkAllocateMemory", __FILE__, __LINE__))
+    {
+      close (fd);
+      g_object_unref (self);
+      return NULL;
+    }
+
+  res = vkBindImageMemory (vk_device, self->image, self->image_memory, 0);
+  if (gulkan_has_error (res, "vkBindImageMemory", __FILE__, __LINE__))
+    {
+      g_object_unref (self);
+      return NULL;
+    }
+
+  VkImageViewCreateInfo image_view_info = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+    .flags = 0,
+    .image = self->image,
+    .viewType = VK_IMAGE_VIEW_TYPE_2D,
+    .format = format,
+    .subresourceRange = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .baseMipLevel = 0,
+      .levelCount = 1,
+      .baseArrayLayer = 0,
+      .layerCount = 1,
+    }
+  };
+  res = vkCreateImageView (vk_device, &image_view_info,
+                           NULL, &self->image_view);
+  if (gulkan_has_error (res, "vkCreateImageView", __FILE__, __LINE__))
+    {
+      g_object_unref (self);
+      return NULL;
+    }
+
+  /* Kept to wait for the producer's implicit fence */
+  self->dmabuf_fd = dup (fds[0]);
+  if (self->dmabuf_fd < 0 || !gulkan_texture_acquire_foreign (self, layout))
+    {
+      g_object_unref (self);
+      return NULL;
+    }
+
+  return self;
+#else
+  (void) client;
+  (void) n_planes;
+  (void) fds;
+  (void) offsets;
+  (void) strides;
+  (void) modifier;
+  (void) extent;
+  (void) format;
+  (void) layout;
+  g_print ("VK_EXT_image_drm_format_modifier not supported in the vulkan SDK gulkan was compiled with!\n");
+  return NULL;
+#endif
+}
+
+#ifdef DMA_BUF_IOCTL_EXPORT_SYNC_FILE
+/* Returns: a sync file of the dma-buf's pending writes, or -1 */
+static int
+_export_sync_file (int dmabuf_fd)
+{
+  struct dma_buf_export_sync_file export = {
+    .flags = DMA_BUF_SYNC_READ,
+    .fd = -1,
+  };
+  int ret;
+  do
+    ret = ioctl (dmabuf_fd, DMA_BUF_IOCTL_EXPORT_SYNC_FILE, &export);
+  while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+
+  /* Kernels before 6.0 don't support this */
+  if (ret != 0)
+    return -1;
+  return export.fd;
+}
+#endif
+
+static void
+_record_foreign_barrier (GulkanTexture   *self,
+                         VkCommandBuffer  cmd_buffer,
+                         GMutex          *mutex,
+                         uint32_t         src_family,
+                         uint32_t         dst_family,
+                         VkAccessFlags    src_access,
+                         VkAccessFlags    dst_access,
+                         VkImageLayout    src_layout,
+                         VkImageLayout    dst_layout)
+{
+  VkImageMemoryBarrier image_memory_barrier =
+  {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+    .srcAccessMask = src_access,
+    .dstAccessMask = dst_access,
+    .oldLayout = src_layout,
+    .newLayout = dst_layout,
+    .image = self->image,
+    .subresourceRange = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .baseMipLevel = 0,
+      .levelCount = 1,
+      .baseArrayLayer = 0,
+      .layerCount = 1,
+    },
+    .srcQueueFamilyIndex = src_family,
+    .dstQueueFamilyIndex = dst_family
+  };
+
+  g_mutex_lock (mutex);
+  vkCmdPipelineBarrier (cmd_buffer,
+                        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                        0, 0, NULL, 0, NULL, 1,
+                        &image_memory_barrier);
+  g_mutex_unlock (mutex);
+}
+
+/*
+ * Prepares acquiring @self: waits until its semaphore is free again and,
+ * if the kernel can export the producer's implicit fence, imports it into
+ * the semaphore. Returns FALSE if @self can't be acquired.
+ */
+static gboolean
+_prepare_acquire_foreign (GulkanTexture *self,
+                          GulkanQueue   *queue,
+                          gboolean      *wait)
+{
+  *wait = FALSE;
+
+  if (self->dmabuf_fd < 0)
+    {
+      g_printerr ("Trying to acquire a texture that is not imported.\n");
+      return FALSE;
+    }
+
+  /* The semaphore can only get a new payload once the last wait is done */
+  if (self->foreign_serial != 0 &&
+      !gulkan_queue_wait (queue, self->foreign_serial))
+    return FALSE;
+
+#ifdef DMA_BUF_IOCTL_EXPORT_SYNC_FILE
+  int sync_fd = _export_sync_file (self->dmabuf_fd);
+  if (sync_fd >= 0)
+    {
+      if (self->foreign_semaphore == VK_NULL_HANDLE)
+        {
+          VkDevice vk_device = gulkan_client_get_device_handle (self->client);
+          VkSemaphoreCreateInfo semaphore_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+          };
+          VkResult res = vkCreateSemaphore (vk_device, &semaphore_info, NULL,
+                                            &self->foreign_semaphore);
+          if (gulkan_has_error (res, "vkCreateSemaphore", __FILE__, __LINE__))
+            self->foreign_semaphore = VK_NULL_HANDLE;
+        }
+
+      GulkanDevice *device = gulkan_client_get_device (self->client);
+      *wait = self->foreign_semaphore != VK_NULL_HANDLE &&
+              gulkan_device_import_semaphore_sync_fd (device,
+                                                      self->foreign_semaphore,
+                                                      sync_fd);
+      if (!*wait)
+        close (sync_fd);
+    }
+#endif
+
+  return TRUE;
+}
+
+/* Records releasing @self back to its producer, if it was acquired before,
+ * and acquiring it again. */
+static void
+_record_acquire_foreign (GulkanTexture   *self,
+                         VkCommandBuffer  cmd_buffer,
+                         GMutex          *mutex,
+                         uint32_t         family,
+                         uint32_t         foreign_family,
+                         VkImageLayout    layout)
+{
+  /* The producer sees the image in GENERAL. On the first acquisition the
+   * image is still UNDEFINED for us, PREINITIALIZED keeps its contents. */
+  VkImageLayout foreign_layout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+  if (self->foreign_layout != VK_IMAGE_LAYOUT_UNDEFINED)
+    {
+      _record_foreign_barrier (self, cmd_buffer, mutex,
+                               family, foreign_family,
+                               _get_access_flags (self->foreign_layout), 0,
+                               self->foreign_layout, VK_IMAGE_LAYOUT_GENERAL);
+      foreign_layout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+
+  _record_foreign_barrier (self, cmd_buffer, mutex,
+                           foreign_family, family,
+                           0, _get_access_flags (layout),
+                           foreign_layout, layout);
+}
+
+/**
+ * gulkan_texture_acquire_foreign:
+ * @self: a #GulkanTexture imported with gulkan_texture_new_from_dmabuf_planes()
+ * @layout: VkImageLayout to acquire the texture into
+ *
+ * Takes ownership of the imported dma-buf from its producer on the graphics
+ * queue, so that it sees what the producer rendered since the last call.
+ * The previous acquisition is released back to the producer first.
+ *
+ * Work submitted to the graphics queue afterwards waits for the producer's
+ * pending writes, if the kernel can export its implicit fence. Otherwise
+ * the writes are assumed to be done, as before.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+gulkan_texture_acquire_foreign (GulkanTexture *self,
+                                VkImageLayout  layout)
+{
+  return gulkan_texture_acquire_foreign_batch (&self, 1, layout);
+}
+
+/**
+ * gulkan_texture_acquire_foreign_batch:
+ * @textures: (array length=n_textures): textures of one #GulkanClient,
+ * imported with gulkan_texture_new_from_dmabuf_planes()
+ * @n_textures: number of @textures
+ * @layout: VkImageLayout to acquire the textures into
+ *
+ * Like gulkan_texture_acquire_foreign() for each of @textures, but with a
+ * single submission that waits for all producers and records all ownership
+ * transfers. Textures that can't be acquired are left out.
+ *
+ * Returns: %TRUE if all textures were acquired.
+ */
+gboolean
+gulkan_texture_acquire_foreign_batch (GulkanTexture **textures,
+                                      guint           n_textures,
+                                      VkImageLayout   layout)
+{
+  if (n_textures == 0)
+    return TRUE;
+
+  GulkanDevice *device = gulkan_client_get_device (textures[0]->client);
+  GulkanQueue *queue = gulkan_device_get_graphics_queue (device);
+  uint32_t family = gulkan_queue_get_family_index (queue);
+  uint32_t foreign_family = gulkan_device_get_foreign_queue_family (device);
+
+  gboolean ret = TRUE;
+  GulkanTexture **acquired = g_new (GulkanTexture *, n_textures);
+  VkSemaphore *semaphores = g_new (VkSemaphore, n_textures);
+  guint n_acquired = 0;
+  uint32_t n_semaphores = 0;
+  for (guint i = 0; i < n_textures; i++)
+    {
+      gboolean wait;
+      if (!_prepare_acquire_foreign (textures[i], queue, &wait))
+        {
+          ret = FALSE;
+          continue;
+        }
+      acquired[n_acquired++] = textures[i];
+      if (wait)
+        semaphores[n_semaphores++] = textures[i]->foreign_semaphore;
+    }
+
+  if (n_acquired == 0)
+    {
+      g_free (acquired);
+      g_free (semaphores);
+      return ret;
+    }
+
+  GulkanCmdBuffer *cmd_buffer = gulkan_queue_request_cmd_buffer (queue);
+  GMutex *mutex = gulkan_queue_get_pool_mutex (queue);
+  g_mutex_lock (mutex);
+  gboolean begun = gulkan_cmd_buffer_begin (cmd_buffer);
+  g_mutex_unlock (mutex);
+
+  uint64_t serial = 0;
+  if (begun)
+    {
+      VkCommandBuffer cmd_buffer_handle =
+        gulkan_cmd_buffer_get_handle (cmd_buffer);
+      for (guint i = 0; i < n_acquired; i++)
+        _record_acquire_foreign (acquired[i], cmd_buffer_handle, mutex,
+                                 family, foreign_family, layout);
+
+      serial = gulkan_queue_submit_wait_async (
+        queue, cmd_buffer, semaphores, n_semaphores,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, NULL);
+    }
+  gulkan_queue_free_cmd_buffer (queue, cmd_buffer);
+
+  /* A semaphore with a payload nothing waits on can't take the next one, so
+   * they are created again on the next acquisition. The textures themselves
+   * are unchanged. */
+  if (serial == 0)
+    {
+      VkDevice vk_device = gulkan_device_get_handle (device);
+      for (guint i = 0; i < n_acquired; i++)
+        {
+          vkDestroySemaphore (vk_device, acquired[i]->foreign_semaphore, NULL);
+          acquired[i]->foreign_semaphore = VK_NULL_HANDLE;
+        }
+      ret = FALSE;
+    }
+  else
+    {
+      for (guint i = 0; i < n_acquired; i++)
+        {
+          acquired[i]->foreign_serial = serial;
+          acquired[i]->foreign_layout = layout;
+        }
+    }
+
+  g_free (acquired);
+  g_free (semaphores);
+  return ret;
+}
+
 /**
  * gulkan_texture_new_export_fd:
  * @client: a #GulkanClient
@@ -889,6 +1808,174 @@ gulkan_texture_transfer_layout (GulkanTexture *self,
   return TRUE;
 }
 
+static void
+_record_barrier (GulkanTexture   *self,
+                 VkCommandBuffer  cmd_buffer,
+                 GMutex          *mutex,
+                 uint32_t         base_level,
+                 uint32_t         level_count,
+                 VkImageLayout    src_layout,
+                 VkImageLayout    dst_layout)
+{
+  VkImageMemoryBarrier image_memory_barrier =
+  {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+    .srcAccessMask = _get_access_flags (src_layout),
+    .dstAccessMask = _get_access_flags (dst_layout),
+    .oldLayout = src_layout,
+    .newLayout = dst_layout,
+    .image = self->image,
+    .subresourceRange = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .baseMipLevel = base_level,
+      .levelCount = level_count,
+      .baseArrayLayer = 0,
+      .layerCount = 1,
+    },
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED
+  };
+
+  g_mutex_lock (mutex);
+  vkCmdPipelineBarrier (cmd_buffer,
+                        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                        0, 0, NULL, 0, NULL, 1,
+                        &image_memory_barrier);
+  g_mutex_unlock (mutex);
+}
+
+static void
+_record_generate_mipmaps (GulkanTexture   *self,
+                          VkCommandBuffer  cmd_buffer,
+                          GMutex          *mutex,
+                          VkImageLayout    src_layout,
+                          VkImageLayout    dst_layout)
+{
+  /* Each level is blitted from the one above it, which is moved to
+   * TRANSFER_SRC once it is written. The previous content of the levels
+   * below the first is discarded. */
+  _record_barrier (self, cmd_buffer, mutex, 0, 1,
+                   src_layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+  if (self->mip_levels > 1)
+    _record_barrier (self, cmd_buffer, mutex, 1, self->mip_levels - 1,
+                     VK_IMAGE_LAYOUT_UNDEFINED,
+                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+  int32_t width = (int32_t) self->extent.width;
+  int32_t height = (int32_t) self->extent.height;
+  for (uint32_t level = 1; level < self->mip_levels; level++)
+    {
+      int32_t level_width = MAX (width / 2, 1);
+      int32_t level_height = MAX (height / 2, 1);
+
+      VkImageBlit blit = {
+        .srcSubresource = {
+          .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+          .mipLevel = level - 1,
+          .baseArrayLayer = 0,
+          .layerCount = 1,
+        },
+        .srcOffsets = { { 0, 0, 0 }, { width, height, 1 } },
+        .dstSubresource = {
+          .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+          .mipLevel = level,
+          .baseArrayLayer = 0,
+          .layerCount = 1,
+        },
+        .dstOffsets = { { 0, 0, 0 }, { level_width, level_height, 1 } },
+      };
+
+      g_mutex_lock (mutex);
+      vkCmdBlitImage (cmd_buffer,
+                      self->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                      self->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                      1, &blit, VK_FILTER_LINEAR);
+      g_mutex_unlock (mutex);
+
+      _record_barrier (self, cmd_buffer, mutex, level, 1,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+      width = level_width;
+      height = level_height;
+    }
+
+  _record_barrier (self, cmd_buffer, mutex, 0, self->mip_levels,
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst_layout);
+}
+
+/**
+ * gulkan_texture_record_generate_mipmaps:
+ * @self: a #GulkanTexture
+ * @cmd_buffer: A command buffer from the graphics queue
+ * @src_layout: Current layout of the texture
+ * @dst_layout: Layout all mip levels are left in
+ *
+ * Records filling all mip levels below the first one by repeatedly halving
+ * the level above with vkCmdBlitImage. The blits need a queue with graphics
+ * support, and the format of @self has to support linear filtered blits.
+ */
+void
+gulkan_texture_record_generate_mipmaps (GulkanTexture   *self,
+                                        VkCommandBuffer  cmd_buffer,
+                                        VkImageLayout    src_layout,
+                                        VkImageLayout    dst_layout)
+{
+  GulkanDevice *device = gulkan_client_get_device (self->client);
+  GulkanQueue *queue = gulkan_device_get_graphics_queue (device);
+  _record_generate_mipmaps (self, cmd_buffer,
+                            gulkan_queue_get_pool_mutex (queue),
+                            src_layout, dst_layout);
+}
+
+/**
+ * gulkan_texture_generate_mipmaps:
+ * @self: a #GulkanTexture
+ * @src_layout: Current layout of the texture
+ * @dst_layout: Layout all mip levels are left in
+ *
+ * Like gulkan_texture_record_generate_mipmaps(), but submits the blits to the
+ * graphics queue and waits for them. Textures whose first level is updated
+ * after creation, e.g. from an imported buffer, can use this to refresh their
+ * mip chain.
+ *
+ * Returns: %TRUE on success, %FALSE if the format of @self can't be blitted
+ * or the submission failed.
+ */
+gboolean
+gulkan_texture_generate_mipmaps (GulkanTexture *self,
+                                 VkImageLayout  src_layout,
+                                 VkImageLayout  dst_layout)
+{
+  if (!_supports_blit_mipmaps (self->client, self->format))
+    {
+      g_warning ("Format %s does not support generating mip levels.\n",
+                 vk_format_string (self->format));
+      return FALSE;
+    }
+
+  GulkanDevice *device = gulkan_client_get_device (self->client);
+  GulkanQueue *queue = gulkan_device_get_graphics_queue (device);
+  GulkanCmdBuffer *cmd_buffer = gulkan_queue_request_cmd_buffer (queue);
+  GMutex *mutex = gulkan_queue_get_pool_mutex (queue);
+  g_mutex_lock (mutex);
+  gboolean ret = gulkan_cmd_buffer_begin (cmd_buffer);
+  g_mutex_unlock (mutex);
+
+  if (ret)
+    {
+      _record_generate_mipmaps (self,
+                                gulkan_cmd_buffer_get_handle (cmd_buffer),
+                                mutex, src_layout, dst_layout);
+      ret = gulkan_queue_submit (queue, cmd_buffer);
+    }
+
+  gulkan_queue_free_cmd_buffer (queue, cmd_buffer);
+
+  return ret;
+}
+
 VkImageView
 gulkan_texture_get_image_view (GulkanTexture *self)
 {
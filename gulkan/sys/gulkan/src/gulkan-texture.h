@@ -44,6 +44,9 @@ gulkan_texture_new_from_pixbuf (GulkanClient   *client,
                                 VkImageLayout   layout,
                                 gboolean        create_mipmaps);
 
+guint
+gulkan_texture_get_mip_level_count (VkExtent2D extent);
+
 GulkanTexture *
 gulkan_texture_new_from_cairo_surface (GulkanClient    *client,
                                        cairo_surface_t *surface,
@@ -56,6 +59,26 @@ gulkan_texture_new_from_dmabuf (GulkanClient *client,
                                 VkExtent2D    extent,
                                 VkFormat      format);
 
+GulkanTexture *
+gulkan_texture_new_from_dmabuf_planes (GulkanClient   *client,
+                                       uint32_t        n_planes,
+                                       const int      *fds,
+                                       const uint32_t *offsets,
+                                       const uint32_t *strides,
+                                       uint64_t        modifier,
+                                       VkExtent2D      extent,
+                                       VkFormat        format,
+                                       VkImageLayout   layout);
+
+gboolean
+gulkan_texture_acquire_foreign (GulkanTexture *self,
+                                VkImageLayout  layout);
+
+gboolean
+gulkan_texture_acquire_foreign_batch (GulkanTexture **textures,
+                                      guint           n_textures,
+                                      VkImageLayout   layout);
+
 GulkanTexture *
 gulkan_texture_new_export_fd (GulkanClient *client,
                               VkExtent2D    extent,
@@ -94,12 +117,36 @@ gulkan_texture_transfer_layout_full (GulkanTexture       *self,
                                      VkPipelineStageFlags src_stage_mask,
                                      VkPipelineStageFlags dst_stage_mask);
 
+void
+gulkan_texture_record_generate_mipmaps (GulkanTexture   *self,
+                                        VkCommandBuffer  cmd_buffer,
+                                        VkImageLayout    src_layout,
+                                        VkImageLayout    dst_layout);
+
+gboolean
+gulkan_texture_generate_mipmaps (GulkanTexture *self,
+                                 VkImageLayout  src_layout,
+                                 VkImageLayout  dst_layout);
+
 gboolean
 gulkan_texture_upload_pixels (GulkanTexture  *self,
                               guchar         *pixels,
                               gsize           size,
                               VkImageLayout   layout);
 
+gboolean
+gulkan_texture_upload_region (GulkanTexture  *self,
+                              guchar         *pixels,
+                              gsize           size,
+                              uint32_t        x,
+                              uint32_t        y,
+                              uint32_t        width,
+                              uint32_t        height,
+                              uint32_t        row_length,
+                              const VkRect2D *rects,
+                              uint32_t        rect_count,
+                              VkImageLayout   layout);
+
 gboolean
 gulkan_texture_upload_cairo_surface (GulkanTexture   *self,
                                      cairo_surface_t *surface,
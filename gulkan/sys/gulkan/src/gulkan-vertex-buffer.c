@@ -74,36 +74,17 @@ _init_from_attribs (GulkanVertexBuffer *self,
   if (!self->buffer)
     return FALSE;
 
+  /* The buffer may share its memory with others, so it can't be mapped with
+   * vkMapMemory directly. */
   void *map;
-  VkResult res = vkMapMemory (self->device,
-                              gulkan_buffer_get_memory_handle (self->buffer),
-                              0, positions_size, 0, &map);
-  vk_check_error ("vkMapMemory", res, FALSE);
+  if (!gulkan_buffer_map (self->buffer, &map))
+    return FALSE;
 
   memcpy (map, positions, positions_size);
+  memcpy ((guchar *) map + self->colors_offset, colors, colors_size);
+  memcpy ((guchar *) map + self->normals_offset, normals, normals_size);
 
-  vkUnmapMemory (self->device, gulkan_buffer_get_memory_handle (self->buffer));
-  vk_check_error ("vkUnmapMemory", res, FALSE);
-
-  res = vkMapMemory (self->device,
-                     gulkan_buffer_get_memory_handle (self->buffer),
-                     self->colors_offset, colors_size, 0, &map);
-  vk_check_error ("vkMapMemory", res, FALSE);
-
-  memcpy (map, colors, colors_size);
-
-  vkUnmapMemory (self->device, gulkan_buffer_get_memory_handle (self->buffer));
-  vk_check_error ("vkUnmapMemory", res, FALSE);
-
-  res = vkMapMemory (self->device,
-                     gulkan_buffer_get_memory_handle (self->buffer),
-                     self->normals_offset, normals_size, 0, &map);
-  vk_check_error ("vkMapMemory", res, FALSE);
-
-  memcpy (map, normals, normals_size);
-
-  vkUnmapMemory (self->device, gulkan_buffer_get_memory_handle (self->buffer));
-  vk_check_error ("vkUnmapMemory", res, FALSE);
+  gulkan_buffer_unmap (self->buffer);
 
   return TRUE;
 }
@@ -458,6 +458,7 @@ extern "C" {
     ) -> *mut GulkanBuffer;
     pub fn gulkan_buffer_get_handle(self_: *mut GulkanBuffer) -> vulkan::VkBuffer;
     pub fn gulkan_buffer_get_memory_handle(self_: *mut GulkanBuffer) -> vulkan::VkDeviceMemory;
+    pub fn gulkan_buffer_get_memory_offset(self_: *mut GulkanBuffer) -> vulkan::VkDeviceSize;
     pub fn gulkan_buffer_map(self_: *mut GulkanBuffer, data: *mut *mut c_void) -> gboolean;
     pub fn gulkan_buffer_unmap(self_: *mut GulkanBuffer);
     pub fn gulkan_buffer_upload(
@@ -531,19 +532,43 @@ extern "C" {
         device: vulkan::VkPhysicalDevice,
         extensions: *mut glib::GSList,
     ) -> gboolean;
+    pub fn gulkan_device_create_semaphore_export_fd(
+        self_: *mut GulkanDevice,
+        fd: *mut c_int,
+    ) -> vulkan::VkSemaphore;
+    pub fn gulkan_device_destroy_semaphore(self_: *mut GulkanDevice, semaphore: vulkan::VkSemaphore);
     pub fn gulkan_device_get_graphics_queue(self_: *mut GulkanDevice) -> *mut GulkanQueue;
     pub fn gulkan_device_get_handle(self_: *mut GulkanDevice) -> vulkan::VkDevice;
     pub fn gulkan_device_get_heap_budget(self_: *mut GulkanDevice, i: u32) -> vulkan::VkDeviceSize;
+    pub fn gulkan_device_get_heap_usage(
+        self_: *mut GulkanDevice,
+        i: u32,
+        allocated: *mut vulkan::VkDeviceSize,
+        used: *mut vulkan::VkDeviceSize,
+        allocation_count: *mut u32,
+    );
     pub fn gulkan_device_get_memory_fd(
         self_: *mut GulkanDevice,
         image_memory: vulkan::VkDeviceMemory,
         fd: *mut c_int,
     ) -> gboolean;
+    pub fn gulkan_device_get_memory_fd_properties(
+        self_: *mut GulkanDevice,
+        fd: c_int,
+        memory_type_bits: *mut u32,
+    ) -> gboolean;
     pub fn gulkan_device_get_physical_device_properties(
         self_: *mut GulkanDevice,
     ) -> *mut vulkan::VkPhysicalDeviceProperties;
     pub fn gulkan_device_get_physical_handle(self_: *mut GulkanDevice) -> vulkan::VkPhysicalDevice;
+    pub fn gulkan_device_get_staging_stats(
+        self_: *mut GulkanDevice,
+        bytes_staged: *mut u64,
+        wraps: *mut u64,
+        fallbacks: *mut u64,
+    );
     pub fn gulkan_device_get_transfer_queue(self_: *mut GulkanDevice) -> *mut GulkanQueue;
+    pub fn gulkan_device_has_drm_format_modifier(self_: *mut GulkanDevice) -> gboolean;
     pub fn gulkan_device_memory_type_from_properties(
         self_: *mut GulkanDevice,
         memory_type_bits: u32,
@@ -606,15 +631,35 @@ extern "C" {
     pub fn gulkan_queue_get_handle(self_: *mut GulkanQueue) -> vulkan::VkQueue;
     pub fn gulkan_queue_get_pool_mutex(self_: *mut GulkanQueue) -> *mut glib::GMutex;
     pub fn gulkan_queue_initialize(self_: *mut GulkanQueue) -> gboolean;
+    pub fn gulkan_queue_is_complete(self_: *mut GulkanQueue, serial: u64) -> gboolean;
     pub fn gulkan_queue_request_cmd_buffer(self_: *mut GulkanQueue) -> *mut GulkanCmdBuffer;
     pub fn gulkan_queue_submit(
         self_: *mut GulkanQueue,
         cmd_buffer: *mut GulkanCmdBuffer,
     ) -> gboolean;
+    pub fn gulkan_queue_submit_async(
+        self_: *mut GulkanQueue,
+        cmd_buffer: *mut GulkanCmdBuffer,
+        resources: gpointer,
+    ) -> u64;
+    pub fn gulkan_queue_submit_wait_async(
+        self_: *mut GulkanQueue,
+        cmd_buffer: *mut GulkanCmdBuffer,
+        wait_semaphores: *const vulkan::VkSemaphore,
+        n_wait_semaphores: u32,
+        stage_mask: vulkan::VkPipelineStageFlags,
+        resources: gpointer,
+    ) -> u64;
     pub fn gulkan_queue_supports_surface(
         self_: *mut GulkanQueue,
         surface: vulkan::VkSurfaceKHR,
     ) -> gboolean;
+    pub fn gulkan_queue_wait(self_: *mut GulkanQueue, serial: u64) -> gboolean;
+    pub fn gulkan_queue_wait_semaphore(
+        self_: *mut GulkanQueue,
+        semaphore: vulkan::VkSemaphore,
+        stage_mask: vulkan::VkPipelineStageFlags,
+    ) -> u64;
 
     //=========================================================================
     // GulkanRenderPass
@@ -754,6 +799,17 @@ extern "C" {
         extent: vulkan::VkExtent2D,
         format: vulkan::VkFormat,
     ) -> *mut GulkanTexture;
+    pub fn gulkan_texture_new_from_dmabuf_planes(
+        client: *mut GulkanClient,
+        n_planes: u32,
+        fds: *const c_int,
+        offsets: *const u32,
+        strides: *const u32,
+        modifier: u64,
+        extent: vulkan::VkExtent2D,
+        format: vulkan::VkFormat,
+        layout: vulkan::VkImageLayout,
+    ) -> *mut GulkanTexture;
     pub fn gulkan_texture_new_from_pixbuf(
         client: *mut GulkanClient,
         pixbuf: *mut gdk_pixbuf::GdkPixbuf,
@@ -767,11 +823,32 @@ extern "C" {
         mip_levels: c_uint,
         format: vulkan::VkFormat,
     ) -> *mut GulkanTexture;
+    pub fn gulkan_texture_acquire_foreign(
+        self_: *mut GulkanTexture,
+        layout: vulkan::VkImageLayout,
+    ) -> gboolean;
+    pub fn gulkan_texture_acquire_foreign_batch(
+        textures: *mut *mut GulkanTexture,
+        n_textures: c_uint,
+        layout: vulkan::VkImageLayout,
+    ) -> gboolean;
+    pub fn gulkan_texture_generate_mipmaps(
+        self_: *mut GulkanTexture,
+        src_layout: vulkan::VkImageLayout,
+        dst_layout: vulkan::VkImageLayout,
+    ) -> gboolean;
     pub fn gulkan_texture_get_extent(self_: *mut GulkanTexture) -> vulkan::VkExtent2D;
     pub fn gulkan_texture_get_format(self_: *mut GulkanTexture) -> vulkan::VkFormat;
     pub fn gulkan_texture_get_image(self_: *mut GulkanTexture) -> vulkan::VkImage;
     pub fn gulkan_texture_get_image_view(self_: *mut GulkanTexture) -> vulkan::VkImageView;
+    pub fn gulkan_texture_get_mip_level_count(extent: vulkan::VkExtent2D) -> c_uint;
     pub fn gulkan_texture_get_mip_levels(self_: *mut GulkanTexture) -> c_uint;
+    pub fn gulkan_texture_record_generate_mipmaps(
+        self_: *mut GulkanTexture,
+        cmd_buffer: vulkan::VkCommandBuffer,
+        src_layout: vulkan::VkImageLayout,
+        dst_layout: vulkan::VkImageLayout,
+    );
     pub fn gulkan_texture_record_transfer(
         self_: *mut GulkanTexture,
         cmd_buffer: vulkan::VkCommandBuffer,
@@ -818,6 +895,19 @@ extern "C" {
         size: size_t,
         layout: vulkan::VkImageLayout,
     ) -> gboolean;
+    pub fn gulkan_texture_upload_region(
+        self_: *mut GulkanTexture,
+        pixels: *mut u8,
+        size: size_t,
+        x: u32,
+        y: u32,
+        width: u32,
+        height: u32,
+        row_length: u32,
+        rects: *const vulkan::VkRect2D,
+        rect_count: u32,
+        layout: vulkan::VkImageLayout,
+    ) -> gboolean;
 
     //=========================================================================
     // GulkanUniformBuffer
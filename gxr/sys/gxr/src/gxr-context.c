@@ -5,12 +5,18 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <string.h>
+
 #include "gxr-context-private.h"
 #include "gxr-config.h"
 #include "gxr-backend-private.h"
 #include "gxr-controller.h"
 #include "gxr-device-manager.h"
 
+/* Snapshots older than this are not handed out, consumers query the runtime
+ * directly instead. Covers one frame at 60 Hz with some slack. */
+#define POSE_SNAPSHOT_MAX_AGE_US 20000
+
 typedef struct _GxrContextPrivate
 {
   GObject parent;
@@ -18,6 +24,12 @@ typedef struct _GxrContextPrivate
   GxrApi api;
 
   GxrDeviceManager *device_manager;
+
+  /* Poses of all devices sampled at one point in time, shared by everyone
+   * asking for a pose until the next input tick or frame. */
+  GMutex pose_mutex;
+  GxrPose poses[GXR_DEVICE_INDEX_MAX];
+  gint64 poses_time;
 } GxrContextPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (GxrContext, gxr_context, G_TYPE_OBJECT)
@@ -305,6 +317,8 @@ gxr_context_init (GxrContext *self)
   priv->api = GXR_API_NONE;
   priv->gc = NULL;
   priv->device_manager = gxr_device_manager_new ();
+  g_mutex_init (&priv->pose_mutex);
+  priv->poses_time = 0;
 }
 
 static void
@@ -316,6 +330,8 @@ gxr_context_finalize (GObject *gobject)
   if (priv->device_manager != NULL)
     g_clear_object (&priv->device_manager);
 
+  g_mutex_clear (&priv->pose_mutex);
+
   /* child classes MUST destroy gulkan after this destructor finishes */
 
   G_OBJECT_CLASS (gxr_context_parent_class)->finalize (gobject);
@@ -345,6 +361,16 @@ gxr_context_set_api (GxrContext *self, GxrApi api)
 gboolean
 gxr_context_get_head_pose (GxrContext *self, graphene_matrix_t *pose)
 {
+  GxrPose snapshot;
+  if (gxr_context_get_device_pose (self, GXR_DEVICE_INDEX_HMD, &snapshot))
+    {
+      if (snapshot.is_valid)
+        graphene_matrix_init_from_matrix (pose, &snapshot.transformation);
+      else
+        graphene_matrix_init_identity (pose);
+      return snapshot.is_valid;
+    }
+
   GxrContextClass *klass = GXR_CONTEXT_GET_CLASS (self);
   if (klass->get_head_pose == NULL)
     return FALSE;
@@ -514,6 +540,16 @@ gxr_context_get_view (GxrContext *self,
   klass->get_view (self, eye, mat);
 }
 
+static void
+_store_pose_snapshot (GxrContext *self, GxrPose *poses)
+{
+  GxrContextPrivate *priv = gxr_context_get_instance_private (self);
+  g_mutex_lock (&priv->pose_mutex);
+  memcpy (priv->poses, poses, sizeof (priv->poses));
+  priv->poses_time = g_get_monotonic_time ();
+  g_mutex_unlock (&priv->pose_mutex);
+}
+
 gboolean
 gxr_context_begin_frame (GxrContext *self)
 {
@@ -525,6 +561,10 @@ gxr_context_begin_frame (GxrContext *self)
 
   gboolean res = klass->begin_frame (self, poses);
 
+  /* Only backends that can sample device poses report real ones here */
+  if (res && klass->get_device_poses != NULL)
+    _store_pose_snapshot (self, poses);
+
   GxrDeviceManager *dm = gxr_context_get_device_manager (self);
   gxr_device_manager_update_poses (dm, poses);
 
@@ -722,3 +762,76 @@ gxr_context_get_acquired_framebuffer (GxrContext *self, uint32_t view)
     return FALSE;
   return klass->get_acquired_framebuffer (self, view);
 }
+
+/**
+ * gxr_context_get_frame_timing:
+ * @self: The #GxrContext
+ * @seconds_since_vsync: (out): Time elapsed since the last vsync of the HMD.
+ * @frame_duration: (out): Duration of one display refresh.
+ *
+ * Returns: %TRUE if the runtime provides frame timing information.
+ */
+gboolean
+gxr_context_get_frame_timing (GxrContext *self,
+                              float      *seconds_since_vsync,
+                              float      *frame_duration)
+{
+  GxrContextClass *klass = GXR_CONTEXT_GET_CLASS (self);
+  if (klass->get_frame_timing == NULL)
+    return FALSE;
+  return klass->get_frame_timing (self, seconds_since_vsync, frame_duration);
+}
+
+/**
+ * gxr_context_update_pose_snapshot:
+ * @self: The #GxrContext
+ *
+ * Samples the poses of all tracked devices at one predicted time and keeps
+ * them for gxr_context_get_head_pose() and gxr_context_get_device_pose().
+ * Meant to be called once per input tick, gxr_context_begin_frame() updates
+ * the snapshot on its own.
+ *
+ * Returns: %TRUE if the backend supports pose snapshots.
+ */
+gboolean
+gxr_context_update_pose_snapshot (GxrContext *self)
+{
+  GxrContextClass *klass = GXR_CONTEXT_GET_CLASS (self);
+  if (klass->get_device_poses == NULL)
+    return FALSE;
+
+  GxrPose poses[GXR_DEVICE_INDEX_MAX];
+  if (!klass->get_device_poses (self, poses, GXR_DEVICE_INDEX_MAX))
+    return FALSE;
+
+  _store_pose_snapshot (self, poses);
+  return TRUE;
+}
+
+/**
+ * gxr_context_get_device_pose:
+ * @self: The #GxrContext
+ * @index: Index of the tracked device.
+ * @pose: (out): The pose from the last snapshot.
+ *
+ * Returns: %TRUE if a recent snapshot was available. The pose itself can
+ * still be invalid, check @pose->is_valid.
+ */
+gboolean
+gxr_context_get_device_pose (GxrContext *self,
+                             uint32_t    index,
+                             GxrPose    *pose)
+{
+  g_return_val_if_fail (index < GXR_DEVICE_INDEX_MAX, FALSE);
+
+  GxrContextPrivate *priv = gxr_context_get_instance_private (self);
+
+  g_mutex_lock (&priv->pose_mutex);
+  gboolean fresh = priv->poses_time != 0 &&
+    g_get_monotonic_time () - priv->poses_time < POSE_SNAPSHOT_MAX_AGE_US;
+  if (fresh)
+    *pose = priv->poses[index];
+  g_mutex_unlock (&priv->pose_mutex);
+
+  return fresh;
+}
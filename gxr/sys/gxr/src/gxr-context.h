@@ -162,6 +162,16 @@ struct _GxrContextClass
 
   GulkanFrameBuffer *
   (*get_acquired_framebuffer) (GxrContext *self, uint32_t view);
+
+  gboolean
+  (*get_frame_timing) (GxrContext *self,
+                       float      *seconds_since_vsync,
+                       float      *frame_duration);
+
+  gboolean
+  (*get_device_poses) (GxrContext *self,
+                       GxrPose    *poses,
+                       uint32_t    count);
 };
 
 GxrContext *gxr_context_new (GxrAppType  type,
@@ -313,6 +323,19 @@ gxr_context_get_view_count (GxrContext *self);
 GulkanFrameBuffer *
 gxr_context_get_acquired_framebuffer (GxrContext *self, uint32_t view);
 
+gboolean
+gxr_context_get_frame_timing (GxrContext *self,
+                              float      *seconds_since_vsync,
+                              float      *frame_duration);
+
+gboolean
+gxr_context_update_pose_snapshot (GxrContext *self);
+
+gboolean
+gxr_context_get_device_pose (GxrContext *self,
+                             uint32_t    index,
+                             GxrPose    *pose);
+
 G_END_DECLS
 
 #endif /* GXR_CONTEXT_H_ */
@@ -21,6 +21,18 @@ typedef struct _GxrOverlayPrivate
   GObjectClass  parent_class;
   GxrContext   *context;
   gboolean      flip_y;
+
+  /*
+   * Local copy of the overlay state, so getters don't have to ask the
+   * runtime, and setters can skip calls that wouldn't change anything.
+   * Only valid when the matching has_ flag is set.
+   */
+  graphene_matrix_t transform;
+  gboolean          has_transform;
+  float             width_meters;
+  gboolean          has_width_meters;
+  VkExtent2D        size_pixels;
+  gboolean          has_size_pixels;
 } GxrOverlayPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (GxrOverlay, gxr_overlay, G_TYPE_OBJECT)
@@ -112,6 +124,9 @@ gxr_overlay_init (GxrOverlay *self)
   GxrOverlayPrivate *priv = gxr_overlay_get_instance_private (self);
   priv->flip_y = FALSE;
   priv->context = NULL;
+  priv->has_transform = FALSE;
+  priv->has_width_meters = FALSE;
+  priv->has_size_pixels = FALSE;
 }
 
 GxrOverlay *
@@ -377,12 +392,35 @@ gxr_overlay_set_mouse_scale (GxrOverlay *self, float width, float height)
   return klass->set_mouse_scale (self, width, height);
 }
 
+/**
+ * gxr_overlay_set_texture_bounds:
+ * @self: The #GxrOverlay
+ * @u_max: Right edge of the shown part, 1.0 is the whole width
+ * @v_max: Bottom edge of the shown part, 1.0 is the whole height
+ *
+ * Only show the top left part of submitted textures, so a texture bigger than
+ * the content can be used.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+gxr_overlay_set_texture_bounds (GxrOverlay *self, float u_max, float v_max)
+{
+  GxrOverlayClass *klass = GXR_OVERLAY_GET_CLASS (self);
+  if (klass->set_texture_bounds == NULL)
+    return FALSE;
+  return klass->set_texture_bounds (self, u_max, v_max);
+}
+
 gboolean
 gxr_overlay_clear_texture (GxrOverlay *self)
 {
   GxrOverlayClass *klass = GXR_OVERLAY_GET_CLASS (self);
   if (klass->clear_texture == NULL)
     return FALSE;
+
+  GxrOverlayPrivate *priv = gxr_overlay_get_instance_private (self);
+  priv->has_size_pixels = FALSE;
   return klass->clear_texture (self);
 }
 
@@ -419,7 +457,14 @@ gxr_overlay_set_width_meters (GxrOverlay *self, float meters)
   GxrOverlayClass *klass = GXR_OVERLAY_GET_CLASS (self);
   if (klass->set_width_meters == NULL)
     return FALSE;
-  return klass->set_width_meters (self, meters);
+
+  GxrOverlayPrivate *priv = gxr_overlay_get_instance_private (self);
+  if (priv->has_width_meters && priv->width_meters == meters)
+    return TRUE;
+
+  priv->has_width_meters = klass->set_width_meters (self, meters);
+  priv->width_meters = meters;
+  return priv->has_width_meters;
 }
 
 gboolean
@@ -429,17 +474,34 @@ gxr_overlay_set_transform_absolute (GxrOverlay *self,
   GxrOverlayClass *klass = GXR_OVERLAY_GET_CLASS (self);
   if (klass->set_transform_absolute == NULL)
     return FALSE;
-  return klass->set_transform_absolute (self, mat);
+
+  GxrOverlayPrivate *priv = gxr_overlay_get_instance_private (self);
+  if (priv->has_transform && graphene_matrix_equal_fast (&priv->transform, mat))
+    return TRUE;
+
+  priv->has_transform = klass->set_transform_absolute (self, mat);
+  graphene_matrix_init_from_matrix (&priv->transform, mat);
+  return priv->has_transform;
 }
 
 gboolean
 gxr_overlay_get_transform_absolute (GxrOverlay *self,
                                     graphene_matrix_t *mat)
 {
+  GxrOverlayPrivate *priv = gxr_overlay_get_instance_private (self);
+  if (priv->has_transform)
+    {
+      graphene_matrix_init_from_matrix (mat, &priv->transform);
+      return TRUE;
+    }
+
   GxrOverlayClass *klass = GXR_OVERLAY_GET_CLASS (self);
   if (klass->get_transform_absolute == NULL)
     return FALSE;
-  return klass->get_transform_absolute (self, mat);
+
+  priv->has_transform = klass->get_transform_absolute (self, mat);
+  graphene_matrix_init_from_matrix (&priv->transform, mat);
+  return priv->has_transform;
 }
 
 gboolean
@@ -449,25 +511,49 @@ gxr_overlay_set_raw (GxrOverlay *self, guchar *pixels,
   GxrOverlayClass *klass = GXR_OVERLAY_GET_CLASS (self);
   if (klass->set_raw == NULL)
     return FALSE;
-  return klass->set_raw (self, pixels, width, height, depth);
+
+  GxrOverlayPrivate *priv = gxr_overlay_get_instance_private (self);
+  priv->has_size_pixels = klass->set_raw (self, pixels, width, height, depth);
+  priv->size_pixels = (VkExtent2D) { .width = width, .height = height };
+  return priv->has_size_pixels;
 }
 
 gboolean
 gxr_overlay_get_size_pixels (GxrOverlay *self, VkExtent2D *size)
 {
+  GxrOverlayPrivate *priv = gxr_overlay_get_instance_private (self);
+  if (priv->has_size_pixels)
+    {
+      *size = priv->size_pixels;
+      return TRUE;
+    }
+
   GxrOverlayClass *klass = GXR_OVERLAY_GET_CLASS (self);
   if (klass->get_size_pixels == NULL)
     return FALSE;
-  return klass->get_size_pixels (self, size);
+
+  priv->has_size_pixels = klass->get_size_pixels (self, size);
+  priv->size_pixels = *size;
+  return priv->has_size_pixels;
 }
 
 gboolean
 gxr_overlay_get_width_meters (GxrOverlay *self, float *width)
 {
+  GxrOverlayPrivate *priv = gxr_overlay_get_instance_private (self);
+  if (priv->has_width_meters)
+    {
+      *width = priv->width_meters;
+      return TRUE;
+    }
+
   GxrOverlayClass *klass = GXR_OVERLAY_GET_CLASS (self);
   if (klass->get_width_meters == NULL)
     return FALSE;
-  return klass->get_width_meters (self, width);
+
+  priv->has_width_meters = klass->get_width_meters (self, width);
+  priv->width_meters = *width;
+  return priv->has_width_meters;
 }
 
 gboolean
@@ -500,7 +586,9 @@ gxr_overlay_submit_texture (GxrOverlay    *self,
 
   GxrOverlayPrivate *priv = gxr_overlay_get_instance_private (self);
   GulkanClient *client = gxr_context_get_gulkan (priv->context);
-  return klass->submit_texture (self, client, texture);
+  priv->has_size_pixels = klass->submit_texture (self, client, texture);
+  priv->size_pixels = gulkan_texture_get_extent (texture);
+  return priv->has_size_pixels;
 }
 
 gboolean
@@ -110,6 +110,10 @@ struct _GxrOverlayClass
   void
   (*set_flip_y) (GxrOverlay *self,
                  gboolean flip_y);
+
+  gboolean
+  (*set_texture_bounds) (GxrOverlay *self,
+                         float u_max, float v_max);
 };
 
 GxrOverlay *
@@ -151,6 +155,9 @@ gxr_overlay_poll_event (GxrOverlay *self);
 gboolean
 gxr_overlay_set_mouse_scale (GxrOverlay *self, float width, float height);
 
+gboolean
+gxr_overlay_set_texture_bounds (GxrOverlay *self, float u_max, float v_max);
+
 gboolean
 gxr_overlay_is_visible (GxrOverlay *self);
 
@@ -25,6 +25,9 @@
 
 #define INVALID_DEVICE_PATH UINT64_MAX
 
+/* How often to query origins again while a controller has none */
+#define DEVICE_PATHS_RETRY_US (G_USEC_PER_SEC / 2)
+
 struct _OpenVRAction
 {
   GxrAction parent;
@@ -34,6 +37,18 @@ struct _OpenVRAction
 
   gboolean controller_update_required;
 
+  /*
+   * Device path of the origin of this action for each tracked device index.
+   * Origins only change when devices come and go, so the table is refreshed
+   * on device manager events instead of on every poll.
+   */
+  VRInputValueHandle_t device_paths[MAX_DEVICE_COUNT];
+  gboolean device_paths_dirty;
+  /* Monotonic time to refresh the table at, 0 if it is complete */
+  gint64 device_paths_retry_time;
+  gulong device_activate_signal;
+  gulong device_deactivate_signal;
+
   /* Only used for DIGITAL_FROM_FLOAT */
   float threshold;
   float last_float[MAX_DEVICE_COUNT];
@@ -55,10 +70,15 @@ openvr_action_init (OpenVRAction *self)
     {
       self->last_float[i] = 0.0f;
       self->last_bool[i] = FALSE;
+      self->device_paths[i] = INVALID_DEVICE_PATH;
     }
   self->haptic_action = NULL;
   self->context = NULL;
   self->controller_update_required = FALSE;
+  self->device_paths_dirty = TRUE;
+  self->device_paths_retry_time = 0;
+  self->device_activate_signal = 0;
+  self->device_deactivate_signal = 0;
 }
 
 void
@@ -91,6 +111,12 @@ openvr_action_update_controllers (OpenVRAction *self)
              gxr_action_get_url (GXR_ACTION (self)));
   self->controller_update_required = FALSE;
 
+  /* Devices added below mark the table dirty again, that's fine */
+  self->device_paths_dirty = FALSE;
+  self->device_paths_retry_time = 0;
+  for (int i = 0; i < MAX_DEVICE_COUNT; i++)
+    self->device_paths[i] = INVALID_DEVICE_PATH;
+
   int origin_count = -1;
   while (origin_handles[++origin_count] != k_ulInvalidInputValueHandle);
 
@@ -106,12 +132,16 @@ openvr_action_update_controllers (OpenVRAction *self)
         {
           g_printerr ("GetOriginTrackedDeviceInfo for %s failed\n",
                       gxr_action_get_url (GXR_ACTION (self)));
+          self->device_paths_dirty = TRUE;
           g_free (origin_handles);
           return;
         }
 
       TrackedDeviceIndex_t device_index  = origin_info.trackedDeviceIndex;
 
+      if (device_index < MAX_DEVICE_COUNT)
+        self->device_paths[device_index] = origin_info.devicePath;
+
       if (!f->system->IsTrackedDeviceConnected (device_index))
         {
           g_debug ("Skipping unconnected device %d\n", device_index);
@@ -143,60 +173,43 @@ openvr_action_update_controllers (OpenVRAction *self)
     }
 
   g_free (origin_handles);
-}
-
-/* TODO: maybe there is a better way */
-static VRInputValueHandle_t
-_index_to_device_path (OpenVRAction *self, TrackedDeviceIndex_t index)
-{
-  OpenVRFunctions *f = openvr_get_functions ();
-
-  GxrActionSet *action_set = gxr_action_get_action_set (GXR_ACTION (self));
-
-  VRActionSetHandle_t actionset_handle =
-    openvr_action_set_get_handle (OPENVR_ACTION_SET (action_set));
-
-  VRInputValueHandle_t *origin_handles =
-  g_malloc (sizeof (VRInputValueHandle_t) * k_unMaxActionOriginCount);
-  EVRInputError err =
-    f->input->GetActionOrigins (actionset_handle, self->handle,
-                                origin_handles, k_unMaxActionOriginCount);
 
-  if (err != EVRInputError_VRInputError_None)
-    {
-      g_printerr ("GetActionOrigins for %s failed, retrying later...\n",
-                  gxr_action_get_url (GXR_ACTION (self)));
-      g_free (origin_handles);
-      return INVALID_DEVICE_PATH;
-    }
-
-  int origin_count = -1;
-  while (origin_handles[++origin_count] != k_ulInvalidInputValueHandle);
-
-  // g_print ("Action %s has %d origins\n", self->url, origin_count);
-
-  for (int i = 0; i < origin_count; i++)
+  /* SteamVR can report a controller before the origins of its bindings,
+   * which would leave it without input until the next device event. Keep
+   * querying while one has no path, but not on every poll, since actions
+   * bound to one hand never get a path for the other. */
+  GxrDeviceManager *dm = gxr_context_get_device_manager (self->context);
+  for (GSList *l = gxr_device_manager_get_controllers (dm); l; l = l->next)
     {
-      InputOriginInfo_t origin_info;
-      err = f->input->GetOriginTrackedDeviceInfo (origin_handles[i],
-                                                  &origin_info,
-                                                  sizeof (origin_info));
-      if (err != EVRInputError_VRInputError_None)
-        {
-          g_printerr ("GetOriginTrackedDeviceInfo for %s failed\n",
-                      gxr_action_get_url (GXR_ACTION (self)));
-          continue;
-        }
-
-      if (origin_info.trackedDeviceIndex == index)
+      TrackedDeviceIndex_t index =
+        (TrackedDeviceIndex_t) gxr_device_get_handle (GXR_DEVICE (l->data));
+      if (index < MAX_DEVICE_COUNT &&
+          self->device_paths[index] == INVALID_DEVICE_PATH)
         {
-          g_free (origin_handles);
-          return origin_info.devicePath;
+          self->device_paths_retry_time =
+            g_get_monotonic_time () + DEVICE_PATHS_RETRY_US;
+          break;
         }
     }
+}
 
-  g_free (origin_handles);
-  return INVALID_DEVICE_PATH;
+static VRInputValueHandle_t
+_index_to_device_path (OpenVRAction *self, TrackedDeviceIndex_t index)
+{
+  if (index >= MAX_DEVICE_COUNT)
+    return INVALID_DEVICE_PATH;
+  return self->device_paths[index];
+}
+
+static void
+_device_changed_cb (GxrDeviceManager *device_manager,
+                    gpointer          event,
+                    gpointer          _self)
+{
+  (void) device_manager;
+  (void) event;
+  OpenVRAction *self = OPENVR_ACTION (_self);
+  self->device_paths_dirty = TRUE;
 }
 
 static OpenVRAction *
@@ -222,9 +235,17 @@ openvr_action_new_from_type_url (GxrContext *context, GxrActionSet *action_set,
   if (!openvr_action_load_handle (self, url))
     {
       g_object_unref (self);
-      self = NULL;
+      return NULL;
     }
 
+  GxrDeviceManager *dm = gxr_context_get_device_manager (context);
+  self->device_activate_signal =
+    g_signal_connect (dm, "device-activate-event",
+                      (GCallback) _device_changed_cb, self);
+  self->device_deactivate_signal =
+    g_signal_connect (dm, "device-deactivate-event",
+                      (GCallback) _device_changed_cb, self);
+
   return self;
 }
 
@@ -264,6 +285,10 @@ _action_poll_digital (OpenVRAction *self)
 
       VRActionHandle_t input_handle = _index_to_device_path (self, index);
 
+      /* no origin for this controller yet, retried in _poll */
+      if (input_handle == INVALID_DEVICE_PATH)
+        continue;
+
       err = f->input->GetDigitalActionData (self->handle, &data,
                                             sizeof(data), input_handle);
 
@@ -274,21 +299,9 @@ _action_poll_digital (OpenVRAction *self)
           return FALSE;
         }
 
-      InputOriginInfo_t origin_info;
-      err = f->input->GetOriginTrackedDeviceInfo (data.activeOrigin,
-                                                 &origin_info,
-                                                  sizeof (origin_info));
-
-      if (err != EVRInputError_VRInputError_None)
-        {
-          /* controller is not active, but might be active later */
-          if (err == EVRInputError_VRInputError_InvalidHandle)
-            continue;
-
-          g_printerr ("ERROR: GetOriginTrackedDeviceInfo: %s\n",
-                      openvr_input_error_string (err));
-          return FALSE;
-        }
+      /* controller is not active, but might be active later */
+      if (data.activeOrigin == k_ulInvalidInputValueHandle)
+        continue;
 
       GxrDigitalEvent *event = g_malloc (sizeof (GxrDigitalEvent));
       event->controller = controller;
@@ -328,6 +341,11 @@ _action_poll_digital_from_float (OpenVRAction *self)
       TrackedDeviceIndex_t index =
         (TrackedDeviceIndex_t) gxr_device_get_handle (GXR_DEVICE (controller));
       VRInputValueHandle_t input_handle = _index_to_device_path (self, index);
+
+      /* no origin for this controller yet, retried in _poll */
+      if (input_handle == INVALID_DEVICE_PATH)
+        continue;
+
       err = f->input->GetAnalogActionData (self->handle, &data,
                                             sizeof(data), input_handle);
 
@@ -338,32 +356,20 @@ _action_poll_digital_from_float (OpenVRAction *self)
           return FALSE;
         }
 
-      InputOriginInfo_t origin_info;
-      err = f->input->GetOriginTrackedDeviceInfo (data.activeOrigin,
-                                                  &origin_info,
-                                                  sizeof (origin_info));
-
-      if (err != EVRInputError_VRInputError_None)
-        {
-          /* controller is not active, but might be active later */
-          if (err == EVRInputError_VRInputError_InvalidHandle)
-            continue;
-
-          g_printerr ("ERROR: GetOriginTrackedDeviceInfo: %s\n",
-                      openvr_input_error_string (err));
-          return FALSE;
-        }
-
+      /* controller is not active, but might be active later */
+      if (data.activeOrigin == k_ulInvalidInputValueHandle ||
+          index >= MAX_DEVICE_COUNT)
+        continue;
 
       if (self->haptic_action &&
           _threshold_passed (self->threshold,
-                              self->last_float[origin_info.trackedDeviceIndex],
+                              self->last_float[index],
                               data.x))
         {
           g_debug ("Threshold %f passed, triggering haptic\n", self->threshold);
           gxr_action_trigger_haptic (GXR_ACTION (self->haptic_action),
                                       0.f, 0.03f, 50.f, 0.4f,
-                                      origin_info.devicePath);
+                                      input_handle);
         }
 
       gboolean currentState = data.x >= self->threshold;
@@ -372,14 +378,13 @@ _action_poll_digital_from_float (OpenVRAction *self)
       event->controller = controller;
       event->active = data.bActive;
       event->state = currentState;
-      event->changed =
-        currentState != self->last_bool[origin_info.trackedDeviceIndex];
+      event->changed = currentState != self->last_bool[index];
       event->time = data.fUpdateTime;
 
       gxr_action_emit_digital (GXR_ACTION (self), event);
 
-      self->last_float[origin_info.trackedDeviceIndex] = data.x;
-      self->last_bool[origin_info.trackedDeviceIndex] = currentState;
+      self->last_float[index] = data.x;
+      self->last_bool[index] = currentState;
     }
 
   return TRUE;
@@ -404,6 +409,11 @@ _action_poll_analog (OpenVRAction *self)
       TrackedDeviceIndex_t index =
         (TrackedDeviceIndex_t) gxr_device_get_handle (GXR_DEVICE (controller));
       VRInputValueHandle_t input_handle = _index_to_device_path (self, index);
+
+      /* no origin for this controller yet, retried in _poll */
+      if (input_handle == INVALID_DEVICE_PATH)
+        continue;
+
       err = f->input->GetAnalogActionData (self->handle, &data,
                                            sizeof(data), input_handle);
 
@@ -414,21 +424,9 @@ _action_poll_analog (OpenVRAction *self)
           return FALSE;
         }
 
-      InputOriginInfo_t origin_info;
-      err = f->input->GetOriginTrackedDeviceInfo (data.activeOrigin,
-                                                 &origin_info,
-                                                  sizeof (origin_info));
-
-      if (err != EVRInputError_VRInputError_None)
-        {
-          /* controller is not active, but might be active later */
-          if (err == EVRInputError_VRInputError_InvalidHandle)
-            continue;
-
-          g_printerr ("ERROR: GetOriginTrackedDeviceInfo: %s\n",
-                      openvr_input_error_string (err));
-          return FALSE;
-        }
+      /* controller is not active, but might be active later */
+      if (data.activeOrigin == k_ulInvalidInputValueHandle)
+        continue;
 
       GxrAnalogEvent *event = g_malloc (sizeof (GxrAnalogEvent));
       event->active = data.bActive;
@@ -443,37 +441,18 @@ _action_poll_analog (OpenVRAction *self)
   return TRUE;
 }
 
-static gboolean
+static void
 _emit_pose_event (OpenVRAction          *self,
+                  GxrController         *controller,
                   InputPoseActionData_t *data)
 {
-  OpenVRFunctions *f = openvr_get_functions ();
-
-  InputOriginInfo_t origin_info;
-  EVRInputError err;
-  err = f->input->GetOriginTrackedDeviceInfo (data->activeOrigin,
-                                             &origin_info,
-                                              sizeof (origin_info));
-  if (err != EVRInputError_VRInputError_None)
-    {
-      /* controller is not active, but might be active later */
-      if (err == EVRInputError_VRInputError_InvalidHandle)
-        return TRUE;
-
-      g_printerr ("ERROR: GetOriginTrackedDeviceInfo: %s\n",
-                  openvr_input_error_string (err));
-      return FALSE;
-    }
-
-  GxrDeviceManager *dm = gxr_context_get_device_manager (self->context);
-  GxrDevice *controller =
-    gxr_device_manager_get (dm, origin_info.trackedDeviceIndex);
-  if (!controller || !gxr_device_is_controller (controller))
-    return TRUE;
+  /* controller is not active, but might be active later */
+  if (data->activeOrigin == k_ulInvalidInputValueHandle)
+    return;
 
   GxrPoseEvent *event = g_malloc (sizeof (GxrPoseEvent));
   event->active = data->bActive;
-  event->controller = GXR_CONTROLLER (controller);
+  event->controller = controller;
   openvr_math_matrix34_to_graphene (&data->pose.mDeviceToAbsoluteTracking,
                                     &event->pose);
   graphene_vec3_init_from_float (&event->velocity,
@@ -484,8 +463,6 @@ _emit_pose_event (OpenVRAction          *self,
   event->device_connected = data->pose.bDeviceIsConnected;
 
   gxr_action_emit_pose (GXR_ACTION (self), event);
-
-  return TRUE;
 }
 
 static gboolean
@@ -497,6 +474,8 @@ _action_poll_pose_secs_from_now (OpenVRAction *self,
   GxrDeviceManager *dm = gxr_context_get_device_manager (self->context);
   GSList *controllers = gxr_device_manager_get_controllers (dm);
 
+  enum ETrackingUniverseOrigin origin = f->compositor->GetTrackingSpace ();
+
   EVRInputError err;
   for(GSList *l = controllers; l; l = l->next)
     {
@@ -506,9 +485,11 @@ _action_poll_pose_secs_from_now (OpenVRAction *self,
         (TrackedDeviceIndex_t) gxr_device_get_handle (GXR_DEVICE (controller));
       VRInputValueHandle_t input_handle = _index_to_device_path (self, index);
 
-      InputPoseActionData_t data;
+      /* no origin for this controller yet, retried in _poll */
+      if (input_handle == INVALID_DEVICE_PATH)
+        continue;
 
-      enum ETrackingUniverseOrigin origin = f->compositor->GetTrackingSpace ();
+      InputPoseActionData_t data;
 
       err = f->input->GetPoseActionDataRelativeToNow (self->handle,
                                                       origin,
@@ -523,9 +504,7 @@ _action_poll_pose_secs_from_now (OpenVRAction *self,
           return FALSE;
         }
 
-      if (!_emit_pose_event (self, &data))
-        return FALSE;
-
+      _emit_pose_event (self, controller, &data);
     }
   return TRUE;
 }
@@ -535,7 +514,9 @@ _poll (GxrAction *action)
 {
   OpenVRAction *self = OPENVR_ACTION (action);
 
-  if (self->controller_update_required)
+  if (self->controller_update_required || self->device_paths_dirty ||
+      (self->device_paths_retry_time != 0 &&
+       g_get_monotonic_time () >= self->device_paths_retry_time))
     openvr_action_update_controllers (self);
 
   GxrActionType type = gxr_action_get_action_type (action);
@@ -593,6 +574,13 @@ _finalize (GObject *gobject)
   OpenVRAction *self = OPENVR_ACTION (gobject);
   if (self->haptic_action)
     g_object_unref (self->haptic_action);
+
+  if (self->device_activate_signal)
+    {
+      GxrDeviceManager *dm = gxr_context_get_device_manager (self->context);
+      g_signal_handler_disconnect (dm, self->device_activate_signal);
+      g_signal_handler_disconnect (dm, self->device_deactivate_signal);
+    }
 }
 
 static void
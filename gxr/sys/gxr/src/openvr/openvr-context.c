@@ -877,6 +877,32 @@ _get_device_extensions (GxrContext   *self,
   return TRUE;
 }
 
+static gboolean
+_get_frame_timing (GxrContext *context,
+                   float      *seconds_since_vsync,
+                   float      *frame_duration)
+{
+  (void) context;
+  return openvr_system_get_frame_timing (seconds_since_vsync, frame_duration);
+}
+
+static gboolean
+_get_device_poses (GxrContext *context,
+                   GxrPose    *poses,
+                   uint32_t    count)
+{
+  (void) context;
+
+  /* Predict to the next vsync, which is when anything derived from these
+   * poses can show up on the HMD at the earliest. */
+  float predicted_seconds = 0.f;
+  float seconds_since_vsync, frame_duration;
+  if (openvr_system_get_frame_timing (&seconds_since_vsync, &frame_duration))
+    predicted_seconds = MAX (frame_duration - seconds_since_vsync, 0.f);
+
+  return openvr_system_get_device_poses (predicted_seconds, poses, count);
+}
+
 static uint32_t
 _get_view_count (GxrContext *context)
 {
@@ -933,4 +959,6 @@ openvr_context_class_init (OpenVRContextClass *klass)
   gxr_context_class->get_device_extensions = _get_device_extensions;
   gxr_context_class->get_view_count = _get_view_count;
   gxr_context_class->get_acquired_framebuffer = _get_acquired_framebuffer;
+  gxr_context_class->get_frame_timing = _get_frame_timing;
+  gxr_context_class->get_device_poses = _get_device_poses;
 }
@@ -34,10 +34,11 @@ struct _OpenVROverlay
   GxrOverlayClass parent;
   VROverlayHandle_t overlay_handle;
   VROverlayHandle_t thumbnail_handle;
-};
 
-static struct VRTextureBounds_t defaultBounds = { 0., 0., 1., 1. };
-static struct VRTextureBounds_t flippedBounds = { 0., 1., 1., 0. };
+  /* Part of the texture that is shown, not flipped */
+  float u_max;
+  float v_max;
+};
 
 G_DEFINE_TYPE (OpenVROverlay, openvr_overlay, GXR_TYPE_OVERLAY)
 
@@ -46,6 +47,8 @@ openvr_overlay_init (OpenVROverlay *self)
 {
   self->overlay_handle = 0;
   self->thumbnail_handle = 0;
+  self->u_max = 1.0f;
+  self->v_max = 1.0f;
 }
 
 static gboolean
@@ -515,18 +518,47 @@ _set_keyboard_position (GxrOverlay      *overlay,
   f->overlay->SetKeyboardPositionForOverlay (self->overlay_handle, rect);
 }
 
+static gboolean
+_update_texture_bounds (OpenVROverlay *self, gboolean flip_y)
+{
+  OpenVRFunctions *f = openvr_get_functions ();
+
+  VRTextureBounds_t bounds = {
+    .uMin = 0.0f,
+    .vMin = flip_y ? self->v_max : 0.0f,
+    .uMax = self->u_max,
+    .vMax = flip_y ? 0.0f : self->v_max,
+  };
+  EVROverlayError err =
+    f->overlay->SetOverlayTextureBounds (self->overlay_handle, &bounds);
+  OVERLAY_CHECK_ERROR ("SetOverlayTextureBounds", err)
+
+  return TRUE;
+}
+
 static void
 _set_flip_y (GxrOverlay *overlay,
              gboolean flip_y)
 {
   OpenVROverlay *self = OPENVR_OVERLAY (overlay);
-  OpenVRFunctions *f = openvr_get_functions ();
 
   if (flip_y != gxr_overlay_get_flip_y (overlay))
-    {
-      VRTextureBounds_t *bounds = flip_y ? &flippedBounds : &defaultBounds;
-      f->overlay->SetOverlayTextureBounds (self->overlay_handle, bounds);
-    }
+    _update_texture_bounds (self, flip_y);
+}
+
+static gboolean
+_set_texture_bounds (GxrOverlay *overlay,
+                     float       u_max,
+                     float       v_max)
+{
+  OpenVROverlay *self = OPENVR_OVERLAY (overlay);
+
+  if (u_max == self->u_max && v_max == self->v_max)
+    return TRUE;
+
+  self->u_max = u_max;
+  self->v_max = v_max;
+  return _update_texture_bounds (self, gxr_overlay_get_flip_y (overlay));
 }
 
 /* Submit frame to OpenVR runtime */
@@ -693,4 +725,5 @@ openvr_overlay_class_init (OpenVROverlayClass *klass)
   parent_class->submit_texture = _submit_texture;
   parent_class->print_info = _print_info;
   parent_class->set_flip_y = _set_flip_y;
+  parent_class->set_texture_bounds = _set_texture_bounds;
 }
@@ -185,3 +185,58 @@ openvr_system_get_device_model_name (uint32_t i)
   return openvr_system_get_device_string (
     i, ETrackedDeviceProperty_Prop_RenderModelName_String);
 }
+
+gboolean
+openvr_system_get_frame_timing (float *seconds_since_vsync,
+                                float *frame_duration)
+{
+  OpenVRFunctions *f = openvr_get_functions ();
+
+  uint64_t frame_counter;
+  if (!f->system->GetTimeSinceLastVsync (seconds_since_vsync, &frame_counter))
+    return FALSE;
+
+  ETrackedPropertyError error;
+  float frequency = f->system->GetFloatTrackedDeviceProperty (
+    k_unTrackedDeviceIndex_Hmd,
+    ETrackedDeviceProperty_Prop_DisplayFrequency_Float, &error);
+
+  if (error != ETrackedPropertyError_TrackedProp_Success || frequency <= 0.f)
+    return FALSE;
+
+  *frame_duration = 1.f / frequency;
+  return TRUE;
+}
+
+/* Samples all devices with a single call, unlike openvr_system_get_hmd_pose
+ * which also checks device class and controller state first. */
+gboolean
+openvr_system_get_device_poses (float    predicted_seconds,
+                                GxrPose *poses,
+                                uint32_t count)
+{
+  g_return_val_if_fail (count <= GXR_DEVICE_INDEX_MAX, FALSE);
+
+  OpenVRFunctions *f = openvr_get_functions ();
+
+  enum ETrackingUniverseOrigin origin = f->compositor->GetTrackingSpace ();
+
+  TrackedDevicePose_t p[GXR_DEVICE_INDEX_MAX];
+  f->system->GetDeviceToAbsoluteTrackingPose (origin, predicted_seconds,
+                                              p, count);
+
+  for (uint32_t i = 0; i < count; i++)
+    {
+      poses[i].is_valid = p[i].bDeviceIsConnected &&
+                          p[i].bPoseIsValid &&
+                          p[i].eTrackingResult ==
+                              ETrackingResult_TrackingResult_Running_OK;
+      if (poses[i].is_valid)
+        openvr_math_matrix34_to_graphene (&p[i].mDeviceToAbsoluteTracking,
+                                          &poses[i].transformation);
+      else
+        graphene_matrix_init_identity (&poses[i].transformation);
+    }
+
+  return TRUE;
+}
@@ -14,6 +14,7 @@
 #include <graphene.h>
 
 #include "gxr-enums.h"
+#include "gxr-types.h"
 #include "openvr-wrapper.h"
 #include "vulkan/vulkan.h"
 
@@ -56,4 +57,13 @@ openvr_system_device_is_controller (uint32_t i);
 gchar*
 openvr_system_get_device_model_name (uint32_t i);
 
+gboolean
+openvr_system_get_frame_timing (float *seconds_since_vsync,
+                                float *frame_duration);
+
+gboolean
+openvr_system_get_device_poses (float    predicted_seconds,
+                                GxrPose *poses,
+                                uint32_t count);
+
 #endif /* GXR_SYSTEM_H_ */
@@ -625,12 +625,14 @@ impl ::std::fmt::Debug for GxrPointerTipSettings {
 #[derive(Copy, Clone)]
 #[repr(C)]
 pub struct GxrPose {
+    pub transformation: graphene::graphene_matrix_t,
     pub is_valid: gboolean,
 }
 
 impl ::std::fmt::Debug for GxrPose {
     fn fmt(&self, f: &mut ::std::fmt::Formatter) -> ::std::fmt::Result {
         f.debug_struct(&format!("GxrPose @ {self:p}"))
+            .field("transformation", &self.transformation)
             .field("is_valid", &self.is_valid)
             .finish()
     }
@@ -946,6 +948,16 @@ extern "C" {
     pub fn gxr_context_end_frame(self_: *mut GxrContext) -> gboolean;
     pub fn gxr_context_get_device_manager(self_: *mut GxrContext) -> *mut GxrDeviceManager;
     pub fn gxr_context_get_device_model_name(self_: *mut GxrContext, i: u32) -> *mut c_char;
+    pub fn gxr_context_get_device_pose(
+        self_: *mut GxrContext,
+        index: u32,
+        pose: *mut GxrPose,
+    ) -> gboolean;
+    pub fn gxr_context_get_frame_timing(
+        self_: *mut GxrContext,
+        seconds_since_vsync: *mut c_float,
+        frame_duration: *mut c_float,
+    ) -> gboolean;
     pub fn gxr_context_get_frustum_angles(
         self_: *mut GxrContext,
         eye: GxrEye,
@@ -954,9 +966,17 @@ extern "C" {
         top: *mut c_float,
         bottom: *mut c_float,
     );
+    pub fn gxr_context_get_head_pose(
+        self_: *mut GxrContext,
+        pose: *mut graphene::graphene_matrix_t,
+    ) -> gboolean;
     pub fn gxr_context_get_model_normal_offset(self_: *mut GxrContext) -> u32;
     pub fn gxr_context_get_model_uv_offset(self_: *mut GxrContext) -> u32;
     pub fn gxr_context_get_model_vertex_stride(self_: *mut GxrContext) -> u32;
+    pub fn gxr_context_get_render_dimensions(
+        self_: *mut GxrContext,
+        extent: *mut vulkan::VkExtent2D,
+    );
     pub fn gxr_context_get_view_count(self_: *mut GxrContext) -> u32;
     pub fn gxr_context_is_another_scene_running(self_: *mut GxrContext) -> gboolean;
     pub fn gxr_context_is_input_available(self_: *mut GxrContext) -> gboolean;
@@ -971,6 +991,7 @@ extern "C" {
     pub fn gxr_context_request_quit(self_: *mut GxrContext);
     pub fn gxr_context_show_keyboard(self_: *mut GxrContext);
     pub fn gxr_context_submit_framebuffers(self_: *mut GxrContext) -> gboolean;
+    pub fn gxr_context_update_pose_snapshot(self_: *mut GxrContext) -> gboolean;
 
     //=========================================================================
     // GxrController
@@ -1089,6 +1110,11 @@ extern "C" {
         depth: u32,
     ) -> gboolean;
     pub fn gxr_overlay_set_sort_order(self_: *mut GxrOverlay, sort_order: u32) -> gboolean;
+    pub fn gxr_overlay_set_texture_bounds(
+        self_: *mut GxrOverlay,
+        u_max: c_float,
+        v_max: c_float,
+    ) -> gboolean;
     pub fn gxr_overlay_set_visibility(self_: *mut GxrOverlay, visibility: gboolean) -> gboolean;
     pub fn gxr_overlay_set_width_meters(self_: *mut GxrOverlay, meters: c_float) -> gboolean;
     pub fn gxr_overlay_show(self_: *mut GxrOverlay) -> gboolean;
@@ -740,6 +740,10 @@ extern "C" {
     );
     pub fn xrd_window_manager_get_buttons(self_: *mut XrdWindowManager) -> *mut glib::GSList;
     pub fn xrd_window_manager_get_hover_mode(self_: *mut XrdWindowManager) -> XrdHoverMode;
+    pub fn xrd_window_manager_get_window_flags(
+        self_: *mut XrdWindowManager,
+        window: *mut XrdWindow,
+    ) -> XrdWindowFlags;
     pub fn xrd_window_manager_get_windows(self_: *mut XrdWindowManager) -> *mut glib::GSList;
     pub fn xrd_window_manager_poll_window_events(
         self_: *mut XrdWindowManager,
@@ -885,6 +889,13 @@ extern "C" {
         self_: *mut XrdWindow,
         texture: *mut gulkan::GulkanTexture,
     );
+    pub fn xrd_window_set_and_submit_texture_region(
+        self_: *mut XrdWindow,
+        texture: *mut gulkan::GulkanTexture,
+        width: u32,
+        height: u32,
+        lod: u32,
+    );
     pub fn xrd_window_set_color(self_: *mut XrdWindow, color: *const graphene::graphene_vec3_t);
     pub fn xrd_window_set_flip_y(self_: *mut XrdWindow, flip_y: gboolean);
     pub fn xrd_window_set_pin(self_: *mut XrdWindow, pinned: gboolean, hide_unpinned: gboolean);
@@ -206,14 +206,24 @@ static void _submit_texture(XrdWindow *window) {
 	gxr_overlay_submit_texture(self->overlay, self->window_data->texture);
 }
 
-static void _set_and_submit_texture(XrdWindow *window, GulkanTexture *texture) {
+static void _set_and_submit_texture_region(XrdWindow *window,
+                                           GulkanTexture *texture,
+                                           uint32_t width, uint32_t height,
+                                           uint32_t lod) {
 	XrdOverlayWindow *self = XRD_OVERLAY_WINDOW(window);
 
 	uint32_t current_width, current_height;
 	g_object_get(self, "texture-width", &current_width, "texture-height",
 	             &current_height, NULL);
 
-	VkExtent2D new_extent = gulkan_texture_get_extent(texture);
+	/* The window is as big as its content, not the texture */
+	VkExtent2D new_extent = {.width = width, .height = height};
+	VkExtent2D texture_extent = gulkan_texture_get_extent(texture);
+	uint32_t lod_width = (width + (1u << lod) - 1) >> lod;
+	uint32_t lod_height = (height + (1u << lod) - 1) >> lod;
+	gxr_overlay_set_texture_bounds(
+	    self->overlay, (float)lod_width / (float)texture_extent.width,
+	    (float)lod_height / (float)texture_extent.height);
 
 	/* update overlay if there is no texture, even if the texture dims
 	 * are already the same */
@@ -259,6 +269,12 @@ static void _set_and_submit_texture(XrdWindow *window, GulkanTexture *texture) {
 		g_object_unref(to_free);
 }
 
+static void _set_and_submit_texture(XrdWindow *window, GulkanTexture *texture) {
+	VkExtent2D extent = gulkan_texture_get_extent(texture);
+	_set_and_submit_texture_region(window, texture, extent.width,
+	                               extent.height, 0);
+}
+
 static GulkanTexture *_get_texture(XrdWindow *window) {
 	XrdOverlayWindow *self = XRD_OVERLAY_WINDOW(window);
 	return self->window_data->texture;
@@ -442,6 +458,7 @@ static void xrd_overlay_window_window_interface_init(XrdWindowInterface *iface)
 	iface->get_transformation_no_scale = _get_transformation_no_scale;
 	iface->submit_texture = _submit_texture;
 	iface->set_and_submit_texture = _set_and_submit_texture;
+	iface->set_and_submit_texture_region = _set_and_submit_texture_region;
 	iface->get_texture = _get_texture;
 	iface->poll_event = _poll_event;
 	iface->add_child = _add_child;
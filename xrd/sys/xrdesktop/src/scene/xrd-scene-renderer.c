@@ -78,6 +78,10 @@ struct _XrdSceneRenderer
 
   GxrContext *context;
 
+  /* Submission of the last frame, the next one waits for it before touching
+   * the uniform buffers the GPU may still read */
+  uint64_t last_frame;
+
   void
   (*render_eye) (uint32_t         eye,
                  VkCommandBuffer  cmd_buffer,
@@ -126,6 +130,7 @@ xrd_scene_renderer_init (XrdSceneRenderer *self)
   self->pipeline_cache = VK_NULL_HANDLE;
 
   self->context = NULL;
+  self->last_frame = 0;
 }
 
 static void
@@ -708,6 +713,9 @@ _draw (XrdSceneRenderer *self)
 
   GulkanQueue *queue = gulkan_device_get_graphics_queue (device);
 
+  if (self->last_frame != 0)
+    gulkan_queue_wait (queue, self->last_frame);
+
   GulkanCmdBuffer *cmd_buffer = gulkan_queue_request_cmd_buffer (queue);
   gulkan_cmd_buffer_begin (cmd_buffer);
 
@@ -717,7 +725,9 @@ _draw (XrdSceneRenderer *self)
 
   _render_stereo (self, cmd_handle);
 
-  gulkan_queue_submit (queue, cmd_buffer);
+  /* The runtime consumes the frame on the same queue, so it only has to be
+   * submitted, not finished, before the framebuffers are handed over. */
+  self->last_frame = gulkan_queue_submit_async (queue, cmd_buffer, NULL);
 
   gulkan_queue_free_cmd_buffer (queue, cmd_buffer);
 
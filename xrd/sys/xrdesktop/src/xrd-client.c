@@ -7,6 +7,7 @@
 
 #include "xrd-client-private.h"
 
+#include <math.h>
 #include <gxr.h>
 
 #include "graphene-ext.h"
@@ -27,6 +28,14 @@
 
 #define APP_NAME "xrdesktop"
 
+/* Poll interval while no controller is connected. Only runtime events like
+ * quit are handled then, which can wait a bit longer. */
+#define IDLE_POLL_INTERVAL_MS 100
+/* Upper bound for the per-frame poll, the old runtime event poll rate */
+#define MAX_FRAME_POLL_INTERVAL_MS 20
+/* How often the measured poll cadence is logged */
+#define POLL_STATS_INTERVAL_US (10 * G_USEC_PER_SEC)
+
 enum {
   KEYBOARD_PRESS_EVENT,
   CLICK_EVENT,
@@ -68,9 +77,15 @@ typedef struct _XrdClientPrivate
   gulong keyboard_press_signal;
   gulong keyboard_close_signal;
 
-  guint poll_runtime_event_source_id;
-  guint poll_input_source_id;
+  /* Runtime events and input are polled from the same source, see
+   * _schedule_poll. */
+  guint poll_source_id;
+  /* Used when the runtime doesn't report frame timing */
   guint poll_input_rate_ms;
+  guint poll_count;
+  gint64 poll_stats_start;
+  /* Whether the last poll failed, so failures are only logged once */
+  gboolean poll_failed;
 
   double analog_threshold;
 
@@ -722,10 +737,8 @@ _finalize (GObject *gobject)
   if (priv->wm_control_container)
     _destroy_buttons (self);
 
-  if (priv->poll_runtime_event_source_id > 0)
-    g_source_remove (priv->poll_runtime_event_source_id);
-  if (priv->poll_input_source_id > 0)
-    g_source_remove (priv->poll_input_source_id);
+  if (priv->poll_source_id > 0)
+    g_source_remove (priv->poll_source_id);
 
   g_hash_table_unref (priv->window_mapping);
 
@@ -887,13 +900,12 @@ _check_hover_grab (XrdClient *self)
 
       xrd_render_unlock ();
 
-      GSList *buttons = xrd_window_manager_get_buttons (priv->manager);
-
       XrdWindow *hovered_window =
         XRD_WINDOW (gxr_controller_get_hover_state (controller)->hovered_object);
       gboolean hovering_window_for_input =
         hovered_window != NULL &&
-        g_slist_find (buttons, hovered_window) == NULL;
+        !(xrd_window_manager_get_window_flags (priv->manager, hovered_window)
+          & XRD_WINDOW_BUTTON);
       XrdWindow *grabbed_window =
         XRD_WINDOW (gxr_controller_get_grab_state (controller)->grabbed_object);
 
@@ -912,7 +924,6 @@ xrd_client_poll_input_events (XrdClient *self)
   if (!priv->context)
     {
       g_printerr ("Error polling events: No Gxr Context\n");
-      priv->poll_input_source_id = 0;
       return FALSE;
     }
 
@@ -932,7 +943,6 @@ xrd_client_poll_input_events (XrdClient *self)
   if (!gxr_action_sets_poll (priv->action_sets, count))
     {
       g_printerr ("Error polling actions\n");
-      priv->poll_input_source_id = 0;
       return FALSE;
     }
 
@@ -1290,15 +1300,14 @@ _window_hover_end_cb (XrdWindow     *window,
   if (controller == xrd_input_synth_get_primary_controller (input_synth))
     xrd_desktop_cursor_hide (priv->cursor);
 
-  GSList *buttons = xrd_window_manager_get_buttons (priv->manager);
-
   gpointer next_hovered =
     gxr_controller_get_hover_state (controller)->hovered_object;
 
   gboolean next_hovered_is_button =
     next_hovered &&
     XRD_IS_WINDOW (next_hovered) &&
-    g_slist_find (buttons, next_hovered);
+    (xrd_window_manager_get_window_flags (priv->manager, next_hovered)
+     & XRD_WINDOW_BUTTON);
 
   if (priv->ignore_input && !next_hovered_is_button)
     gxr_controller_hide_pointer (controller);
@@ -1403,7 +1412,6 @@ static void
 _hide_pointers (XrdClient *self, gboolean except_button_hover)
 {
   XrdClientPrivate *priv = xrd_client_get_instance_private (self);
-  GSList *buttons = xrd_window_manager_get_buttons (priv->manager);
 
   GxrDeviceManager *dm = gxr_context_get_device_manager (priv->context);
   GSList *controllers = gxr_device_manager_get_controllers (dm);
@@ -1412,7 +1420,11 @@ _hide_pointers (XrdClient *self, gboolean except_button_hover)
       XrdWindow *window =
         XRD_WINDOW (gxr_controller_get_hover_state (l->data)->hovered_object);
 
-      if (!(except_button_hover && window && g_slist_find (buttons, window)))
+      gboolean is_button =
+        (xrd_window_manager_get_window_flags (priv->manager, window)
+         & XRD_WINDOW_BUTTON) != 0;
+
+      if (!(except_button_hover && is_button))
         gxr_controller_hide_pointer (l->data);
     }
 }
@@ -1794,14 +1806,8 @@ _update_input_poll_rate (GSettings *settings, gchar *key, gpointer _self)
   XrdClient *self = _self;
   XrdClientPrivate *priv = xrd_client_get_instance_private (self);
 
-  if (priv->poll_input_source_id != 0)
-    g_source_remove (priv->poll_input_source_id);
+  /* Picked up when the next poll is scheduled */
   priv->poll_input_rate_ms = g_settings_get_uint (settings, key);
-
-  priv->poll_input_source_id =
-      g_timeout_add (priv->poll_input_rate_ms,
-      (GSourceFunc) xrd_client_poll_input_events,
-      self);
 }
 
 static void
@@ -1824,8 +1830,9 @@ _synth_click_cb (XrdInputSynth *synth,
 
   event->window = XRD_WINDOW (hover_window);
 
-  GSList *buttons = xrd_window_manager_get_buttons (priv->manager);
-  gboolean is_button = g_slist_find (buttons, hover_window) != NULL;
+  gboolean is_button =
+    (xrd_window_manager_get_window_flags (priv->manager, event->window)
+     & XRD_WINDOW_BUTTON) != 0;
 
   if (!is_button)
     {
@@ -2057,8 +2064,11 @@ xrd_client_init (XrdClient *self)
                                   "show-only-pinned-startup", 
                                   &priv->pinned_only);
 
-  priv->poll_runtime_event_source_id = 0;
-  priv->poll_input_source_id = 0;
+  priv->poll_source_id = 0;
+  priv->poll_input_rate_ms = 0;
+  priv->poll_count = 0;
+  priv->poll_stats_start = g_get_monotonic_time ();
+  priv->poll_failed = FALSE;
   priv->keyboard_window = NULL;
   priv->keyboard_press_signal = 0;
   priv->keyboard_close_signal = 0;
@@ -2159,6 +2169,100 @@ _create_wm_action_set (XrdClient *self)
   return set;
 }
 
+/*
+ * While a controller is connected, poll once per frame, right after vsync,
+ * so the input is fresh for the frame the runtime is about to present.
+ * Without controllers there is nothing to track, only runtime events like
+ * quit and device activation, so back off to IDLE_POLL_INTERVAL_MS.
+ */
+static guint
+_next_poll_interval_ms (XrdClient *self)
+{
+  XrdClientPrivate *priv = xrd_client_get_instance_private (self);
+
+  GxrDeviceManager *dm = gxr_context_get_device_manager (priv->context);
+  if (gxr_device_manager_get_controllers (dm) == NULL)
+    return IDLE_POLL_INTERVAL_MS;
+
+  float seconds_since_vsync, frame_duration;
+  if (!gxr_context_get_frame_timing (priv->context, &seconds_since_vsync,
+                                     &frame_duration))
+    return MAX (priv->poll_input_rate_ms, 1);
+
+  float ms = (frame_duration - seconds_since_vsync) * 1000.f;
+  return (guint) CLAMP (ceilf (ms), 1.f, MAX_FRAME_POLL_INTERVAL_MS);
+}
+
+static void
+_update_poll_stats (XrdClient *self)
+{
+  XrdClientPrivate *priv = xrd_client_get_instance_private (self);
+
+  priv->poll_count++;
+
+  gint64 now = g_get_monotonic_time ();
+  gint64 elapsed = now - priv->poll_stats_start;
+  if (elapsed < POLL_STATS_INTERVAL_US)
+    return;
+
+  float seconds = (float) elapsed / G_USEC_PER_SEC;
+  g_debug ("Polled %.1f times/s, every %.1f ms on average\n",
+           priv->poll_count / seconds,
+           seconds * 1000.f / priv->poll_count);
+
+  priv->poll_count = 0;
+  priv->poll_stats_start = now;
+}
+
+static void
+_schedule_poll (XrdClient *self);
+
+static gboolean
+_poll_cb (gpointer _self)
+{
+  XrdClient *self = _self;
+  XrdClientPrivate *priv = xrd_client_get_instance_private (self);
+  priv->poll_source_id = 0;
+
+  /* A quit event handler could drop the last reference */
+  g_object_ref (self);
+
+  /* Without a context there is nothing to poll, ever */
+  if (!priv->context)
+    {
+      g_object_unref (self);
+      return G_SOURCE_REMOVE;
+    }
+
+  /* Everything looking at device poses during this tick, pointer ray, hover
+   * and the head pose for window placement, shares one sample. */
+  gxr_context_update_pose_snapshot (priv->context);
+
+  /* Polling can fail for a while, e.g. when actions are not bound yet. That
+   * must not stop it for good. */
+  gboolean ok = xrd_client_poll_runtime_events (self) &&
+                xrd_client_poll_input_events (self);
+  if (!ok && !priv->poll_failed)
+    g_printerr ("Polling VR input failed, retrying.\n");
+  else if (ok && priv->poll_failed)
+    g_debug ("Polling VR input works again.\n");
+  priv->poll_failed = !ok;
+
+  _update_poll_stats (self);
+  _schedule_poll (self);
+
+  g_object_unref (self);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+_schedule_poll (XrdClient *self)
+{
+  XrdClientPrivate *priv = xrd_client_get_instance_private (self);
+  priv->poll_source_id =
+    g_timeout_add (_next_poll_interval_ms (self), _poll_cb, self);
+}
+
 static void
 _init_gxr_callbacks (XrdClient *self)
 {
@@ -2167,8 +2271,7 @@ _init_gxr_callbacks (XrdClient *self)
   g_signal_connect (priv->context, "quit-event",
                     (GCallback) _system_quit_cb, self);
 
-  priv->poll_runtime_event_source_id =
-    g_timeout_add (20, (GSourceFunc) xrd_client_poll_runtime_events, self);
+  _schedule_poll (self);
 }
 
 void
@@ -20,21 +20,45 @@
 #define M_PI (3.14159265358979323846)
 #endif
 
+/* Hover test data of a hoverable window. Only recomputed when the window
+ * transformation or texture size changed since the last hover test. */
+typedef struct
+{
+  gboolean cached;
+  graphene_matrix_t transform;
+  uint32_t texture_width;
+  uint32_t texture_height;
+
+  graphene_matrix_t inverse_transform;
+  graphene_plane_t plane;
+  graphene_sphere_t bounds;
+  float aspect_ratio;
+} XrdHoverCache;
+
+/* A managed window and its roles. Slots are kept in the order the windows
+ * were added, which is e.g. the order they are arranged in. */
+typedef struct
+{
+  XrdWindow *window;
+  XrdWindowFlags flags;
+  XrdHoverCache hover;
+} XrdWindowSlot;
+
 struct _XrdWindowManager
 {
   GObject parent;
 
-  GSList *draggable_windows;
-  GSList *managed_windows;
-  GSList *hoverable_windows;
-  GSList *destroy_windows;
-  GSList *containers;
+  /* XrdWindowSlot of all managed windows, including buttons */
+  GArray *slots;
 
-  /* all windows except XRD_WINDOW_BUTTON */
-  GSList *all_windows;
+  GSList *containers;
 
-  /* XRD_WINDOW_BUTTON */
-  GSList *buttons;
+  /* Views for xrd_window_manager_get_windows() and
+   * xrd_window_manager_get_buttons(), rebuilt after windows were added or
+   * removed. */
+  GSList *windows_view;
+  GSList *buttons_view;
+  gboolean views_dirty;
 
   gboolean controls_shown;
 
@@ -49,6 +73,9 @@ enum {
 };
 static guint manager_signals[LAST_SIGNAL] = { 0 };
 
+/* Slot index + 1 of a managed window, stored on the window */
+static GQuark slot_quark;
+
 static void
 xrd_window_manager_finalize (GObject *gobject);
 
@@ -65,17 +92,18 @@ xrd_window_manager_class_init (XrdWindowManagerClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
 
   object_class->finalize = xrd_window_manager_finalize;
+
+  slot_quark = g_quark_from_static_string ("xrd-window-manager-slot");
 }
 
 static void
 xrd_window_manager_init (XrdWindowManager *self)
 {
-  self->all_windows = NULL;
-  self->buttons = NULL;
-  self->draggable_windows = NULL;
-  self->managed_windows = NULL;
-  self->destroy_windows = NULL;
-  self->hoverable_windows = NULL;
+  self->slots = g_array_new (FALSE, FALSE, sizeof (XrdWindowSlot));
+  self->containers = NULL;
+  self->windows_view = NULL;
+  self->buttons_view = NULL;
+  self->views_dirty = FALSE;
   self->hover_mode = XRD_HOVER_MODE_EVERYTHING;
 
   /* TODO: possible steamvr issue: When input poll rate is high and buttons are
@@ -95,16 +123,57 @@ xrd_window_manager_finalize (GObject *gobject)
 {
   XrdWindowManager *self = XRD_WINDOW_MANAGER (gobject);
 
-  /* remove the window manager's reference to all windows */
-  g_slist_free_full (self->all_windows, g_object_unref);
-  g_slist_free_full (self->buttons, g_object_unref);
+  for (guint i = 0; i < self->slots->len; i++)
+    {
+      XrdWindowSlot *slot = &g_array_index (self->slots, XrdWindowSlot, i);
+
+      g_object_set_qdata (G_OBJECT (slot->window), slot_quark, NULL);
+
+      /* Freed with manager */
+      if (slot->flags & XRD_WINDOW_DESTROY_WITH_PARENT)
+        g_object_unref (slot->window);
+
+      /* remove the window manager's reference to the window */
+      g_object_unref (slot->window);
+    }
 
-  g_slist_free (self->hoverable_windows);
+  g_array_unref (self->slots);
   g_slist_free (self->containers);
-  g_slist_free (self->draggable_windows);
-  g_slist_free (self->managed_windows);
+  g_slist_free (self->windows_view);
+  g_slist_free (self->buttons_view);
+}
 
-  g_slist_free_full (self->destroy_windows, g_object_unref);
+static XrdWindowSlot *
+_get_slot (XrdWindowManager *self, gpointer window)
+{
+  if (window == NULL)
+    return NULL;
+
+  guint index =
+    GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (window), slot_quark));
+  if (index == 0 || index > self->slots->len)
+    return NULL;
+
+  XrdWindowSlot *slot = &g_array_index (self->slots, XrdWindowSlot, index - 1);
+  return slot->window == window ? slot : NULL;
+}
+
+/* Iterates the windows that have any of the @role flags: returns the next
+ * one at or after *cursor and moves the cursor past it, NULL at the end. */
+static XrdWindow *
+_next_window (XrdWindowManager *self, XrdWindowFlags role, guint *cursor)
+{
+  for (; *cursor < self->slots->len; (*cursor)++)
+    {
+      XrdWindowSlot *slot =
+        &g_array_index (self->slots, XrdWindowSlot, *cursor);
+      if (slot->flags & role)
+        {
+          (*cursor)++;
+          return slot->window;
+        }
+    }
+  return NULL;
 }
 
 static gboolean
@@ -158,27 +227,13 @@ _interpolate_cb (gpointer _transition)
   return TRUE;
 }
 
-static gboolean
-_is_in_list (GSList *list,
-             XrdWindow *window)
-{
-  GSList *l;
-  for (l = list; l != NULL; l = l->next)
-    {
-      if (l->data == window)
-        return TRUE;
-    }
-  return FALSE;
-}
-
 void
 xrd_window_manager_arrange_reset (XrdWindowManager *self)
 {
-  GSList *l;
-  for (l = self->managed_windows; l != NULL; l = l->next)
+  guint cursor = 0;
+  XrdWindow *window;
+  while ((window = _next_window (self, XRD_WINDOW_MANAGED, &cursor)) != NULL)
     {
-      XrdWindow *window = (XrdWindow *) l->data;
-
       XrdTransformTransition *transition = g_malloc (sizeof *transition);
       transition->last_timestamp = g_get_monotonic_time ();
 
@@ -233,7 +288,10 @@ gboolean
 xrd_window_manager_arrange_sphere (XrdWindowManager *self,
                                    GxrContext       *context)
 {
-  guint num_overlays = g_slist_length (self->managed_windows);
+  guint num_overlays = 0;
+  guint cursor = 0;
+  while (_next_window (self, XRD_WINDOW_MANAGED, &cursor) != NULL)
+    num_overlays++;
 
   double root_num_overlays = sqrt((double) num_overlays);
 
@@ -273,6 +331,7 @@ xrd_window_manager_arrange_sphere (XrdWindowManager *self,
   float radius = 5.0f;
 
   guint i = 0;
+  cursor = 0;
   for (float theta = theta_start; theta > theta_end - 0.01f; theta -= theta_step)
     {
       for (float phi = phi_start; phi < phi_end + 0.01f; phi += phi_step)
@@ -302,7 +361,7 @@ xrd_window_manager_arrange_sphere (XrdWindowManager *self,
                                         graphene_vec3_y_axis ());
 
           XrdWindow *window =
-              (XrdWindow *) g_slist_nth_data (self->managed_windows, i);
+              _next_window (self, XRD_WINDOW_MANAGED, &cursor);
 
           if (window == NULL)
             {
@@ -359,37 +418,35 @@ xrd_window_manager_add_window (XrdWindowManager *self,
                                XrdWindow *window,
                                XrdWindowFlags flags)
 {
+  if (_get_slot (self, window) != NULL)
+    {
+      g_printerr ("Window is already managed.\n");
+      return;
+    }
+
   xrd_render_lock ();
-  /* any window must be either in all_windows or buttons */
   if (flags & XRD_WINDOW_BUTTON)
     {
-      self->buttons = g_slist_append (self->buttons, window);
       if (!self->controls_shown)
         xrd_window_hide (window);
     }
   else
     {
-      self->all_windows = g_slist_append (self->all_windows, window);
       GSettings *settings = xrd_settings_get_instance ();
       gboolean pin_new_window = g_settings_get_boolean(settings, "pin-new-windows");
       xrd_window_set_pin(window, pin_new_window, FALSE);
     }
 
-  /* Freed with manager */
-  if (flags & XRD_WINDOW_DESTROY_WITH_PARENT)
-    self->destroy_windows = g_slist_append (self->destroy_windows, window);
-
-  /* Movable overlays (user can move them) */
-  if (flags & XRD_WINDOW_DRAGGABLE)
-    self->draggable_windows = g_slist_append (self->draggable_windows, window);
+  XrdWindowSlot new_slot = {
+    .window = window,
+    .flags = flags,
+    .hover = { .cached = FALSE },
+  };
 
-  /* Managed overlays (window manager can move them) */
-  if (flags & XRD_WINDOW_MANAGED)
-    self->managed_windows = g_slist_append (self->managed_windows, window);
-
-  /* All windows that can be hovered, includes button windows */
-  if (flags & XRD_WINDOW_HOVERABLE)
-    self->hoverable_windows = g_slist_append (self->hoverable_windows, window);
+  g_array_append_val (self->slots, new_slot);
+  g_object_set_qdata (G_OBJECT (window), slot_quark,
+                      GUINT_TO_POINTER (self->slots->len));
+  self->views_dirty = TRUE;
 
   /* keep the window referenced as long as the window manages this window */
   g_object_ref (window);
@@ -400,11 +457,10 @@ void
 xrd_window_manager_poll_window_events (XrdWindowManager *self,
                                        GxrContext       *context)
 {
-  for (GSList *l = self->hoverable_windows; l != NULL; l = l->next)
-    {
-      XrdWindow *window = (XrdWindow *) l->data;
-      xrd_window_poll_event (window);
-    }
+  guint cursor = 0;
+  XrdWindow *window;
+  while ((window = _next_window (self, XRD_WINDOW_HOVERABLE, &cursor)) != NULL)
+    xrd_window_poll_event (window);
 
   for (GSList *l = self->containers; l != NULL; l = l->next)
     {
@@ -417,12 +473,22 @@ void
 xrd_window_manager_remove_window (XrdWindowManager *self,
                                   XrdWindow *window)
 {
-  self->all_windows = g_slist_remove (self->all_windows, window);
-  self->buttons = g_slist_remove (self->buttons, window);
-  self->destroy_windows = g_slist_remove (self->destroy_windows, window);
-  self->draggable_windows = g_slist_remove (self->draggable_windows, window);
-  self->managed_windows = g_slist_remove (self->managed_windows, window);
-  self->hoverable_windows = g_slist_remove (self->hoverable_windows, window);
+  XrdWindowSlot *slot = _get_slot (self, window);
+  if (slot == NULL)
+    return;
+
+  guint index = (guint) (slot - (XrdWindowSlot *) self->slots->data);
+  g_array_remove_index (self->slots, index);
+  g_object_set_qdata (G_OBJECT (window), slot_quark, NULL);
+  self->views_dirty = TRUE;
+
+  /* The windows after it moved down by one */
+  for (guint i = index; i < self->slots->len; i++)
+    {
+      XrdWindowSlot *moved = &g_array_index (self->slots, XrdWindowSlot, i);
+      g_object_set_qdata (G_OBJECT (moved->window), slot_quark,
+                          GUINT_TO_POINTER (i + 1));
+    }
 
   for (GSList *l = self->containers; l != NULL; l = l->next)
     {
@@ -434,34 +500,70 @@ xrd_window_manager_remove_window (XrdWindowManager *self,
   g_object_unref (window);
 }
 
-/* TODO: move somewhere better */
-static gboolean
-_controller_intersects (GxrController *controller,
-                        XrdWindow *window,
-                        graphene_point3d_t *intersection_point)
+static void
+_update_hover_cache (XrdWindow *window, XrdHoverCache *entry)
 {
-  GxrPointer *p = gxr_controller_get_pointer (controller);
+  graphene_matrix_t transform;
+  xrd_window_get_transformation (window, &transform);
 
-  graphene_plane_t plane;
-  xrd_window_get_plane (window, &plane);
+  XrdWindowData *data = xrd_window_get_data (window);
 
-  graphene_matrix_t window_transform;
-  xrd_window_get_transformation (window, &window_transform);
+  if (entry->cached &&
+      entry->texture_width == data->texture_width &&
+      entry->texture_height == data->texture_height &&
+      graphene_matrix_equal_fast (&entry->transform, &transform))
+    return;
+
+  entry->cached = TRUE;
+  graphene_matrix_init_from_matrix (&entry->transform, &transform);
+  entry->texture_width = data->texture_width;
+  entry->texture_height = data->texture_height;
+
+  xrd_window_get_plane (window, &entry->plane);
+  graphene_matrix_inverse (&transform, &entry->inverse_transform);
+
+  entry->aspect_ratio = (float) data->texture_width /
+                        (float) data->texture_height;
+
+  /* The window quad spans aspect x 1 in its local space, scale is part of
+   * the transformation. */
+  float half_width = entry->aspect_ratio / 2.0f;
+  graphene_point3d_t corners[4] = {
+    { .x = -half_width, .y = -0.5f, .z = 0 },
+    { .x =  half_width, .y = -0.5f, .z = 0 },
+    { .x =  half_width, .y =  0.5f, .z = 0 },
+    { .x = -half_width, .y =  0.5f, .z = 0 },
+  };
+  for (int i = 0; i < 4; i++)
+    graphene_matrix_transform_point3d (&transform, &corners[i], &corners[i]);
+
+  graphene_point3d_t center;
+  graphene_ext_matrix_get_translation_point3d (&transform, &center);
+  graphene_sphere_init_from_points (&entry->bounds, 4, corners, &center);
+}
 
-  float aspect_ratio = xrd_window_get_aspect_ratio (window);
+static gboolean
+_ray_intersects (XrdHoverCache      *entry,
+                 graphene_ray_t     *ray,
+                 graphene_point3d_t *intersection_point)
+{
+  /* Cheap rejection of windows the ray does not come close to */
+  if (!graphene_ray_intersects_sphere (ray, &entry->bounds))
+    return FALSE;
 
-  float distance;
-  graphene_vec3_t intersection_vec;
+  float distance = graphene_ray_get_distance_to_plane (ray, &entry->plane);
+  if (distance == INFINITY)
+    return FALSE;
 
-  gboolean intersects =
-    gxr_pointer_get_plane_intersection (p, &plane, &window_transform,
-                                        aspect_ratio, &distance,
-                                        &intersection_vec);
+  graphene_ray_get_position_at (ray, distance, intersection_point);
 
-  if (intersects)
-    graphene_point3d_init_from_vec3 (intersection_point, &intersection_vec);
+  graphene_point3d_t local;
+  graphene_matrix_transform_point3d (&entry->inverse_transform,
+                                     intersection_point, &local);
 
-  return intersects;
+  return local.x >= -entry->aspect_ratio / 2.0f &&
+         local.x <= entry->aspect_ratio / 2.0f &&
+         local.y >= -0.5f && local.y <= 0.5f;
 }
 
 static XrdWindow *
@@ -474,23 +576,33 @@ _get_hover_target (XrdWindowManager  *self,
   *intersection_distance = FLT_MAX;
   graphene_point3d_t point;
 
-  for (GSList *l = self->hoverable_windows; l != NULL; l = l->next)
+  graphene_ray_t ray;
+  gxr_pointer_get_ray (gxr_controller_get_pointer (controller), &ray);
+
+  for (guint i = 0; i < self->slots->len; i++)
     {
-      XrdWindow *window = (XrdWindow *) l->data;
+      XrdWindowSlot *slot = &g_array_index (self->slots, XrdWindowSlot, i);
+
+      if (!(slot->flags & XRD_WINDOW_HOVERABLE))
+        continue;
 
-      if (!xrd_window_is_visible (window))
+      if (self->hover_mode == XRD_HOVER_MODE_BUTTONS &&
+          !(slot->flags & XRD_WINDOW_BUTTON))
         continue;
 
-      if (self->hover_mode == XRD_HOVER_MODE_BUTTONS)
-        if (g_slist_find (self->buttons, window) == NULL)
-          continue;
+      if (!xrd_window_is_visible (slot->window))
+        continue;
+
+      _update_hover_cache (slot->window, &slot->hover);
+      if (slot->hover.texture_height == 0)
+        continue;
 
-      if (_controller_intersects (controller, window, &point))
+      if (_ray_intersects (&slot->hover, &ray, &point))
         {
           float distance = gxr_controller_get_distance (controller, &point);
           if (distance < *intersection_distance)
             {
-              closest = window;
+              closest = slot->window;
               *intersection_distance = distance;
               graphene_point3d_init_from_point (intersection_point, &point);
             }
@@ -547,7 +659,8 @@ xrd_window_manager_drag_start (XrdWindowManager *self,
                                GxrController    *controller)
 {
   GxrHoverState *hover_state = gxr_controller_get_hover_state (controller);
-  if (!_is_in_list (self->draggable_windows, hover_state->hovered_object))
+  XrdWindowSlot *slot = _get_slot (self, hover_state->hovered_object);
+  if (slot == NULL || !(slot->flags & XRD_WINDOW_DRAGGABLE))
     return;
 
   XrdWindow *window = XRD_WINDOW (hover_state->hovered_object);
@@ -705,16 +818,73 @@ xrd_window_manager_update_controller (XrdWindowManager  *self,
 
 }
 
+static void
+_update_views (XrdWindowManager *self)
+{
+  if (!self->views_dirty)
+    return;
+
+  g_slist_free (self->windows_view);
+  g_slist_free (self->buttons_view);
+  self->windows_view = NULL;
+  self->buttons_view = NULL;
+
+  /* prepend backwards to keep slot order */
+  for (guint i = self->slots->len; i > 0; i--)
+    {
+      XrdWindowSlot *slot = &g_array_index (self->slots, XrdWindowSlot, i - 1);
+      if (slot->flags & XRD_WINDOW_BUTTON)
+        self->buttons_view = g_slist_prepend (self->buttons_view, slot->window);
+      else
+        self->windows_view = g_slist_prepend (self->windows_view, slot->window);
+    }
+
+  self->views_dirty = FALSE;
+}
+
+/**
+ * xrd_window_manager_get_windows:
+ * @self: The #XrdWindowManager
+ *
+ * Returns: (transfer none) (element-type XrdWindow): All managed windows
+ * except buttons. The list is owned by the window manager and only valid
+ * until a window is added or removed.
+ */
 GSList *
 xrd_window_manager_get_windows (XrdWindowManager *self)
 {
-  return self->all_windows;
+  _update_views (self);
+  return self->windows_view;
 }
 
+/**
+ * xrd_window_manager_get_buttons:
+ * @self: The #XrdWindowManager
+ *
+ * Returns: (transfer none) (element-type XrdWindow): All managed buttons.
+ * The list is owned by the window manager and only valid until a window is
+ * added or removed.
+ */
 GSList *
 xrd_window_manager_get_buttons (XrdWindowManager *self)
 {
-  return self->buttons;
+  _update_views (self);
+  return self->buttons_view;
+}
+
+/**
+ * xrd_window_manager_get_window_flags:
+ * @self: The #XrdWindowManager
+ * @window: (nullable): A #XrdWindow
+ *
+ * Returns: The flags @window was added with, 0 if it is not managed.
+ */
+XrdWindowFlags
+xrd_window_manager_get_window_flags (XrdWindowManager *self,
+                                     XrdWindow        *window)
+{
+  XrdWindowSlot *slot = _get_slot (self, window);
+  return slot != NULL ? slot->flags : 0;
 }
 
 void
@@ -157,6 +157,10 @@ xrd_window_manager_get_windows (XrdWindowManager *self);
 GSList *
 xrd_window_manager_get_buttons (XrdWindowManager *self);
 
+XrdWindowFlags
+xrd_window_manager_get_window_flags (XrdWindowManager *self,
+                                     XrdWindow        *window);
+
 void
 xrd_window_manager_set_hover_mode (XrdWindowManager *self,
                                    XrdHoverMode mode);
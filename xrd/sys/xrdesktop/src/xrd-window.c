@@ -321,6 +321,42 @@ xrd_window_set_and_submit_texture (XrdWindow     *self,
   iface->set_and_submit_texture (self, texture);
 }
 
+/**
+ * xrd_window_set_and_submit_texture_region:
+ * @self: The #XrdWindow
+ * @texture: A #GulkanTexture that is created by the caller.
+ * Ownership of this texture is transferred to the #XrdWindow.
+ * @width: Width of the window content, in pixels
+ * @height: Height of the window content, in pixels
+ * @lod: Level of detail, the content is downscaled by 2^@lod in @texture
+ *
+ * Like xrd_window_set_and_submit_texture(), but the window content only
+ * covers the top left @width x @height pixels of @texture. This allows
+ * reusing a bigger texture when the window is resized.
+ *
+ * With a @lod above 0, the content covers @width / 2^@lod x @height / 2^@lod
+ * pixels, rounded up, so distant windows can be submitted at a lower
+ * resolution. The window size and input coordinates still use @width and
+ * @height.
+ *
+ * Windows that don't support this show the whole texture.
+ */
+void
+xrd_window_set_and_submit_texture_region (XrdWindow     *self,
+                                          GulkanTexture *texture,
+                                          uint32_t       width,
+                                          uint32_t       height,
+                                          uint32_t       lod)
+{
+  XrdWindowInterface* iface = XRD_WINDOW_GET_IFACE (self);
+  if (iface->set_and_submit_texture_region == NULL)
+    {
+      iface->set_and_submit_texture (self, texture);
+      return;
+    }
+  iface->set_and_submit_texture_region (self, texture, width, height, lod);
+}
+
 /**
  * xrd_window_get_texture:
  * @self: The #XrdWindow
@@ -84,6 +84,8 @@ typedef struct XrdWindowData {
  * @get_transformation_no_scale: Get a #graphene_matrix_t transformation without scale.
  * @submit_texture: Submits current texture to the rendering backend.
  * @set_and_submit_texture: Sets and submits a new texture to the window.
+ * @set_and_submit_texture_region: Sets and submits a new texture to the window,
+ * of which only the top left part is shown, possibly downscaled.
  * @get_texture: Returns current window texture.
  * @poll_event: Poll events on the window.
  * @emit_grab_start: Emit an event when the grab action was started.
@@ -129,6 +131,13 @@ struct _XrdWindowInterface
   (*set_and_submit_texture) (XrdWindow     *self,
                              GulkanTexture *texture);
 
+  void
+  (*set_and_submit_texture_region) (XrdWindow     *self,
+                                    GulkanTexture *texture,
+                                    uint32_t       width,
+                                    uint32_t       height,
+                                    uint32_t       lod);
+
   GulkanTexture *
   (*get_texture) (XrdWindow *self);
 
@@ -228,6 +237,13 @@ void
 xrd_window_set_and_submit_texture (XrdWindow *self,
                                    GulkanTexture *texture);
 
+void
+xrd_window_set_and_submit_texture_region (XrdWindow     *self,
+                                          GulkanTexture *texture,
+                                          uint32_t       width,
+                                          uint32_t       height,
+                                          uint32_t       lod);
+
 GulkanTexture *
 xrd_window_get_texture (XrdWindow *self);
 